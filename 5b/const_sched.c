@@ -11,7 +11,10 @@
  *		   currently running job, and the next job to be run.
  *		   This cost is exceeded by queue traversal costs when number
  *		   of processes is over about 60 on a 4 CPU box.
- *		   Uniprocessor and 2.4 have no known problems.
+ *		   On 2.4 each CPU now rotates its own queue, whose head
+ *		   sits in a cache line of its own, so a pick only dirties
+ *		   the global lines when taking new wakeups or stealing.
+ *		   Uniprocessor has no known problems.
  *
  * COPYRIGHT: HEWLETT-PACKARD CO. 2000
  * released under GNU GENERAL PUBLIC LICENSE
@@ -20,10 +23,11 @@
  * 2000-09-20   initial creation.
  * 2000-10-25   conversion to Linux 2_4 test 9
  * 2001-03-31   fixed uniprocessor/laptop hang under IO stress for 2_4 only
+ * 2026-10-19   per-cpu round robin queues for 2_4
  */
 
 /* update this every patch or release */
-#define CTRR_SCHED_VERSION "constant time round robin scheduler 1.3"  
+#define CTRR_SCHED_VERSION "constant time round robin scheduler 1.4"  
 
 #include <linux/module.h> /* dynamic modules */
 #include <linux/init.h>   /* init macro */
@@ -50,6 +54,21 @@ struct file_operations ctrr_fops = { NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 static struct sched_policy *ctrr_of_cpu[NR_CPUS];
 static struct sched_policy round_robin;
 
+#if (LINUX_VERSION_CODE >= 0x020400)
+/*
+ * one round robin queue per cpu, each head in its own cache line.
+ * wakeups land on the global run queue, and the next cpu to schedule
+ * adopts them; a cpu with nothing of its own steals from the others.
+ * del_from_runqueue only unlinks run_list, so sleeping works from any
+ * of these lists.  all of them are protected by runqueue_lock.
+ */
+struct ctrr_queue {
+	struct list_head head;
+} ____cacheline_aligned;
+
+static struct ctrr_queue ctrr_rq[NR_CPUS];
+#endif
+
 /*------------------------------*
  *  scheduler-visible routines  *
  *------------------------------*/
@@ -61,7 +80,8 @@ ctrr_choose_task(struct task_struct *curr_task, int this_cpu)
 	int keep = 0;
 
 #if (LINUX_VERSION_CODE >= 0x020400)
-	struct list_head *tmp;
+	struct list_head *tmp, *rq = &ctrr_rq[this_cpu].head;
+	int i;
 
 	/* short cut. just keep running current job if we can */
         if ((curr_task->state == TASK_RUNNING)&&
@@ -71,28 +91,43 @@ ctrr_choose_task(struct task_struct *curr_task, int this_cpu)
 		keep = 1;
 	} 
 
-	list_for_each(tmp, &runqueue_head) {
-		p = list_entry(tmp, struct task_struct, run_list);
+	/* adopt new wakeups; only a peek at the global head otherwise */
+	if (!list_empty(&runqueue_head)){
+		list_splice(&runqueue_head, rq->prev);
+		INIT_LIST_HEAD(&runqueue_head);
+	}
+
+	/* own queue first, then steal from the other cpus */
+	for (i = 0; i < NR_CPUS; i++) {
+		struct list_head *q = &ctrr_rq[(this_cpu + i) % NR_CPUS].head;
+
+		list_for_each(tmp, q) {
+			p = list_entry(tmp, struct task_struct, run_list);
 #ifdef CONFIG_SMP
-		if (p->has_cpu || (p->policy & SCHED_YIELD)){
-			continue;
-		}
+			if (p->has_cpu || (p->policy & SCHED_YIELD)){
+				continue;
+			}
 #else 
-		if (p->policy & SCHED_YIELD){
-                        continue;
-                }
+			if (p->policy & SCHED_YIELD){
+                        	continue;
+                	}
 #endif
-		/* perform simple preempt test */
-		if (keep && (curr_task->counter >= p->counter))
-			return curr_task;
+			/* perform simple preempt test */
+			if (keep && (curr_task->counter >= p->counter))
+				return curr_task;
 
-                /* remove from front of queue and stick back on the back */
-		list_del(&p->run_list);
-		list_add_tail(&p->run_list, &runqueue_head);
+                	/* remove from front of queue and stick on the back of ours */
+			list_del(&p->run_list);
+			list_add_tail(&p->run_list, rq);
 
-                p->counter = NICE_TO_TICKS(p->nice);
-                return p;
-        }
+                	p->counter = NICE_TO_TICKS(p->nice);
+                	return p;
+        	}
+
+		/* a job worth keeping beats stealing one */
+		if (keep)
+			return curr_task;
+	}
 
 	/* nothing good found.  fall thru to current or idle */
 	if (keep)
@@ -161,6 +196,11 @@ init_module(void)
 	new->sp_choose_task = ctrr_choose_task;
 	new->sp_preemptability = ctrr_preemptability;
 
+#if (LINUX_VERSION_CODE >= 0x020400)
+        for (i = 0; i < NR_CPUS; i++)
+		INIT_LIST_HEAD(&ctrr_rq[i].head);
+#endif
+
 	/* build per-cpu policy */
         for (i = 0; i < NR_CPUS; i++)
 		ctrr_of_cpu[i] = new;
@@ -182,6 +222,20 @@ init_module(void)
 void
 cleanup_module(void)
 {
+#if (LINUX_VERSION_CODE >= 0x020400)
+	int i;
+#endif
+
 	unregister_sched(CTRR_SCHED_VERSION);
+
+#if (LINUX_VERSION_CODE >= 0x020400)
+	/* give the runnables back to the stock scheduler */
+	spin_lock_irq(&runqueue_lock);
+        for (i = 0; i < NR_CPUS; i++) {
+		list_splice(&ctrr_rq[i].head, &runqueue_head);
+		INIT_LIST_HEAD(&ctrr_rq[i].head);
+	}
+	spin_unlock_irq(&runqueue_lock);
+#endif
 }
 #endif
@@ -0,0 +1,220 @@
+/*
+ * const_sched_bench.c : user space harness for the constant time round
+ *			 robin scheduler.
+ *
+ * const_sched.c warns that on SMP the O(1) pick thrashes cache, because
+ * every cpu dirties the shared queue head and the list pointers of the
+ * jobs around it, and that this only pays off against the stock O(n)
+ * goodness scan once there are about 60 processes on a 4 cpu box.
+ * Here one thread per cpu picks jobs as fast as it can, all under one
+ * global lock as under runqueue_lock, three ways:
+ *
+ *   scan    walk every job for the best counter, like the stock scheduler
+ *   shared  rotate the head of one shared queue, like const_sched 1.3
+ *   percpu  rotate a queue of our own with a cache line padded head
+ *
+ * The crossover only shows with real cpus; on a uniprocessor no line
+ * ever leaves the one cache and scan simply grows with the job count.
+ *
+ * usage: const_sched_bench [threads] [picks per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#define CACHE_LINE	64
+#define MAX_THREADS	64
+#define NICE_TICKS	6
+
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define list_entry(ptr, type, member) \
+	((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+
+static void
+list_init(struct list_head *h)
+{
+	h->next = h->prev = h;
+}
+
+static void
+list_del(struct list_head *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+}
+
+static void
+list_add_tail(struct list_head *n, struct list_head *h)
+{
+	n->prev = h->prev;
+	n->next = h;
+	h->prev->next = n;
+	h->prev = n;
+}
+
+/* a job fills a cache line, as a task_struct fills several */
+struct job {
+	struct list_head run_list;
+	int		counter;
+	int		has_cpu;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct queue {
+	struct list_head head;
+} __attribute__((aligned(CACHE_LINE)));
+
+static pthread_spinlock_t runqueue_lock;
+static struct queue global_rq;
+static struct queue cpu_rq[MAX_THREADS];
+static struct job *jobs;
+static int njobs, nthreads;
+static long picks;
+
+enum { SCAN, SHARED, PERCPU };
+static int mode;
+
+static struct job *
+pick_scan(void)
+{
+	/* stock: best counter over every job, recompute when all run out */
+	struct list_head *tmp;
+	struct job *p, *choice;
+	int high;
+
+recheck:
+	high = -1;
+	choice = NULL;
+	for (tmp = global_rq.head.next; tmp != &global_rq.head; tmp = tmp->next) {
+		p = list_entry(tmp, struct job, run_list);
+		if (!p->has_cpu && p->counter > high) {
+			high = p->counter;
+			choice = p;
+		}
+	}
+	if (!high) {
+		for (tmp = global_rq.head.next; tmp != &global_rq.head; tmp = tmp->next)
+			list_entry(tmp, struct job, run_list)->counter = NICE_TICKS;
+		goto recheck;
+	}
+	return choice;
+}
+
+static struct job *
+pick_rotate(struct list_head *rq)
+{
+	/* const_sched: first job not running moves to the back */
+	struct list_head *tmp;
+	struct job *p;
+
+	for (tmp = rq->next; tmp != rq; tmp = tmp->next) {
+		p = list_entry(tmp, struct job, run_list);
+		if (p->has_cpu)
+			continue;
+		list_del(&p->run_list);
+		list_add_tail(&p->run_list, rq);
+		p->counter = NICE_TICKS;
+		return p;
+	}
+	return NULL;
+}
+
+static void *
+cpu_main(void *arg)
+{
+	long cpu = (long)arg, n;
+	struct job *curr = NULL, *next;
+
+	for (n = 0; n < picks; n++) {
+		pthread_spin_lock(&runqueue_lock);
+		if (curr)
+			curr->has_cpu = 0;
+		if (mode == SCAN)
+			next = pick_scan();
+		else if (mode == SHARED)
+			next = pick_rotate(&global_rq.head);
+		else
+			next = pick_rotate(&cpu_rq[cpu].head);
+		if (next) {
+			next->has_cpu = 1;
+			next->counter--;
+		}
+		curr = next;
+		pthread_spin_unlock(&runqueue_lock);
+	}
+
+	pthread_spin_lock(&runqueue_lock);
+	if (curr)
+		curr->has_cpu = 0;
+	pthread_spin_unlock(&runqueue_lock);
+	return NULL;
+}
+
+static double
+run(int how)
+{
+	pthread_t tid[MAX_THREADS];
+	struct timespec t0, t1;
+	long i;
+
+	/* deal the jobs out again for this mode */
+	list_init(&global_rq.head);
+	for (i = 0; i < nthreads; i++)
+		list_init(&cpu_rq[i].head);
+	for (i = 0; i < njobs; i++) {
+		jobs[i].counter = NICE_TICKS;
+		jobs[i].has_cpu = 0;
+		if (how == PERCPU)
+			list_add_tail(&jobs[i].run_list, &cpu_rq[i % nthreads].head);
+		else
+			list_add_tail(&jobs[i].run_list, &global_rq.head);
+	}
+
+	mode = how;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&tid[i], NULL, cpu_main, (void *)i);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) /
+	       ((double)picks * nthreads);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const int sizes[] = { 8, 16, 32, 48, 60, 64, 96, 128, 256 };
+	unsigned int s;
+
+	nthreads = argc > 1 ? atoi(argv[1]) : 4;
+	picks = argc > 2 ? atol(argv[2]) : 200000;
+	if (nthreads < 1 || nthreads > MAX_THREADS) {
+		fprintf(stderr, "threads must be 1..%d\n", MAX_THREADS);
+		return 1;
+	}
+	pthread_spin_init(&runqueue_lock, PTHREAD_PROCESS_PRIVATE);
+
+	printf("%d cpus, %ld picks each, ns per pick\n", nthreads, picks);
+	printf("jobs\t      scan\t    shared\t    percpu\n");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		double scan, shared, percpu;
+
+		njobs = sizes[s];
+		if (posix_memalign((void **)&jobs, CACHE_LINE, njobs * sizeof(struct job))) {
+			perror("posix_memalign");
+			return 1;
+		}
+		scan = run(SCAN);
+		shared = run(SHARED);
+		percpu = run(PERCPU);
+		printf("%d\t%10.1f\t%10.1f\t%10.1f\n", njobs, scan, shared, percpu);
+		free(jobs);
+	}
+	return 0;
+}
@@ -33,9 +33,17 @@
  * 2001-01-24   port to linux 2_4_0, added choose_cpu
  * 2001-02-15   deleted unnecessary PSET_GETDFLTPSET
  * 2001-07-16   converted to cpus_allowed implementation (2.4.4)
+ * 2026-10-19   per-pset run queues for pset_choose_task
+ * 2026-10-19   lazy epoch based counter replenishment
+ * 2026-10-19   bit scan for GETNEXTSPU, added PSIOC_TOPOLOGY
+ * 2026-10-19   pid hash lookup for P_PID binds, added PSIOC_BINDV
+ * 2026-10-19   lock-free query path on a sequence-checked snapshot
+ * 2026-10-19   per-cpu usage accounting, added PSIOC_GETSTATS
+ * 2026-10-19   optional load driven rebalancer, MINSPUS/MAXSPUS attributes
+ * 2026-10-19   P_TGID binds through thread_group, P_UID binds
  */
 
-#define PSET_VERSION "pset 2.0"  /* update this every patch or release */
+#define PSET_VERSION "pset 2.8"  /* update this every patch or release */
 
 #include <linux/module.h> /* dynamic modules */
 #include <linux/init.h>   /* init macro */
@@ -51,8 +59,11 @@
 #include <linux/config.h>
 #include <linux/kernel.h>
 #include <linux/kmod.h>
+#include <linux/timer.h>
+#include <linux/tqueue.h>
 
 #include "pset.h"
+#include "pset_balance.h"
 
 /* internal structures */
 typedef struct processor_set_priv {
@@ -62,6 +73,12 @@ typedef struct processor_set_priv {
         pset_attrval_t  ps_non_empty_op; /* behavior on delete of set in use */
         struct sched_policy* ps_next;    /* next pset in sorted list */
         struct sched_policy* ps_prev;    /* previous pset in sorted list */
+	struct list_head ps_runqueue;    /* runnable tasks bound to this set */
+	unsigned long   ps_epoch;        /* counters older than this are stale */
+	pset_stats_t    ps_retired;      /* usage by cpus that have since left */
+	int             ps_min_spus;     /* rebalancing bounds */
+	int             ps_max_spus;
+	unsigned long   ps_load;         /* smoothed runnables, rebalancer only */
 } processor_set_priv_t;
 
 #define PSET_PRIV(x) ((processor_set_priv_t *)(&(x)->sp_private))
@@ -73,7 +90,32 @@ static rwlock_t psetlist_lock = RW_LOCK_UNLOCKED;
 static psetid_t max_ps_id = PS_MAXPSET;
 static struct sched_policy *pset_of_cpu[NR_CPUS];
 
+/*
+ * lazy counter replenishment.  instead of rewriting the counter of every
+ * runnable task when a pset runs out of ticks, the pset just takes a new
+ * epoch number, and each task gets fresh ticks the first time it is looked
+ * at in the new epoch.  numbers come from one sequence so tasks in the
+ * shared pool can be compared against the epoch of any pset.
+ * both are protected by runqueue_lock.
+ */
+static unsigned long pset_epoch_seq = 0;
+static unsigned long pset_epoch_of_pid[PID_MAX];
+
+/*
+ * usage accounting.  each cpu counts into its own cache line while it
+ * dispatches, under runqueue_lock, and the totals of a pset are the sum
+ * over its member cpus plus whatever cpus that left it had counted.
+ */
+struct pset_cpu_acct {
+	pset_stats_t    stats;           /* since the cpu joined its pset */
+	unsigned long   last_jiffies;    /* when we last dispatched */
+	int             last_idle;       /* did we pick the idle task */
+} ____cacheline_aligned;
+
+static struct pset_cpu_acct pset_acct[NR_CPUS];
+
 static int pset_ioctl(struct inode *, struct file *, unsigned int, unsigned long);
+static int pset_assign_spu(psetid_t, int, psetid_t *);
 
 struct file_operations pset_fops = {
 	ioctl:		pset_ioctl
@@ -108,20 +150,103 @@ static int pset_busy = 0;
  *  scheduler-visible routines  *
  *------------------------------*/
 
+static inline void
+pset_sort_runqueue(void)
+{
+	/*
+	 * move newly runnable tasks bound to a pset off the global run queue
+	 * and onto the run queue of their own pset.  del_from_runqueue only
+	 * unlinks run_list, so a task may go to sleep from either list, and
+	 * a wakeup always puts it back on runqueue_head for us to find here.
+	 * realtime jobs and kernel threads stay behind in the shared pool.
+	 * runqueue_lock must be held.
+	 */
+	struct list_head *tmp, *next;
+	struct task_struct *p;
+
+	list_for_each_safe(tmp, next, &runqueue_head)
+	{
+		p = list_entry(tmp, struct task_struct, run_list);
+		if (use_default_sched(p))
+			continue;
+		list_del(tmp);
+		list_add_tail(tmp, &PSET_PRIV(p->alt_policy)->ps_runqueue);
+	}
+}
+
+static inline void
+pset_requeue(struct task_struct *p)
+{
+	/*
+	 * hand a runnable task back to the global run queue, so the next
+	 * pset_sort_runqueue files it under whatever pset it belongs to now.
+	 * runqueue_lock must be held.
+	 */
+	if (task_on_runqueue(p)){
+		list_del(&p->run_list);
+		list_add(&p->run_list, &runqueue_head);
+	}
+}
+
+static inline void
+pset_refresh(struct task_struct *p, unsigned long epoch)
+{
+	/* first look at a task in a new epoch hands out its fresh ticks */
+	if (pset_epoch_of_pid[p->pid] < epoch){
+		pset_epoch_of_pid[p->pid] = epoch;
+		p->counter = NICE_TO_TICKS(p->nice);
+	}
+}
+
+static inline void
+pset_stats_add(pset_stats_t *sum, pset_stats_t *more)
+{
+	sum->run_ticks += more->run_ticks;
+	sum->idle_ticks += more->idle_ticks;
+	sum->switches += more->switches;
+	sum->rq_depth_sum += more->rq_depth_sum;
+	sum->rq_samples += more->rq_samples;
+	sum->recomputes += more->recomputes;
+}
+
+static inline void
+pset_acct_retire(int cpu, struct sched_policy *old)
+{
+	/*
+	 * a cpu is leaving its pset: credit what it counted to that set, or
+	 * drop it if the set is going away.  runqueue_lock must be held.
+	 */
+	if (old)
+		pset_stats_add(&PSET_PRIV(old)->ps_retired, &pset_acct[cpu].stats);
+	memset(&pset_acct[cpu].stats, 0, sizeof(pset_stats_t));
+}
+
 static struct task_struct *
 pset_choose_task(struct task_struct *curr_task, int this_cpu)
 {
-        int high;
+        int high, depth = 0, first = 1;
         struct task_struct *p, *choice, *idle = idle_task(this_cpu);
-	struct list_head *tmp;
+	struct list_head *tmp, *pset_rq;
+	processor_set_priv_t *priv = PSET_PRIV(pset_of_cpu[this_cpu]);
+	struct pset_cpu_acct *acct = &pset_acct[this_cpu];
+	unsigned long now = jiffies;
 
 	/*
 	 * choose the most eligible task in this pset or the realtime pool.
          * note that the runqueue lock is held throughout the routine.
-         * this is okay, because we loop a maximum of 3 times over the
-         * run queue (recompute case).  This also prevents multiple CPUs
-	 * from doing the same recompute.
+	 * tasks bound to other psets live on other run queues, so we only
+	 * walk the shared pool plus our own set, at most twice
+	 * (recompute case).  Starting a new epoch under the lock also
+	 * prevents multiple CPUs from doing the same recompute.
 	 */
+	pset_sort_runqueue();
+	pset_rq = &priv->ps_runqueue;
+
+	/* charge the time since the last dispatch to what we ran then */
+	if (acct->last_idle)
+		acct->stats.idle_ticks += now - acct->last_jiffies;
+	else acct->stats.run_ticks += now - acct->last_jiffies;
+	acct->last_jiffies = now;
 
 recheck:
 	high = IDLE_WEIGHT;
@@ -129,15 +254,20 @@ recheck:
 
 	/* with the advent of 2.4 test 9, SCHED_YIELD is no longer handled */
 	if ((curr_task->state == TASK_RUNNING) && is_visible(curr_task, this_cpu)){
+		pset_refresh(curr_task, priv->ps_epoch);
 		high = goodness(curr_task, this_cpu, curr_task->active_mm);
 		if (high >= 0)
 			choice = curr_task;
 	}
 
-	/* pick the most runnable task in pset of this cpu */
+	/* pick the most runnable task in the realtime pool */
 	list_for_each(tmp, &runqueue_head)
 	{
 		p = list_entry(tmp, struct task_struct, run_list);
+		if (!is_visible(p, this_cpu))
+			continue;
+		pset_refresh(p, priv->ps_epoch);
+		depth += first;
 		if (can_choose(p, this_cpu)) {
 			int w = goodness(p, this_cpu, curr_task->active_mm);
 			if (w > high){
@@ -147,20 +277,205 @@ recheck:
 		}
 	}
 
-	/* if we had runnables with no ticks left, replenish counters */
-	if (!high){
-		list_for_each(tmp, &runqueue_head)
-		{
-			p = list_entry(tmp, struct task_struct, run_list);
-			if (is_visible(p, this_cpu))
-				p->counter = NICE_TO_TICKS(p->nice);
+	/* pick the most runnable task in pset of this cpu */
+	list_for_each(tmp, pset_rq)
+	{
+		p = list_entry(tmp, struct task_struct, run_list);
+		pset_refresh(p, priv->ps_epoch);
+		depth += first;
+		if (can_choose(p, this_cpu)) {
+			int w = goodness(p, this_cpu, curr_task->active_mm);
+			if (w > high){
+				high = w;
+				choice = p;
+			}
 		}
+	}
+
+	/* if we had runnables with no ticks left, start a new epoch */
+	if (!high){
+		priv->ps_epoch = ++pset_epoch_seq;
+		acct->stats.recomputes++;
+		first = 0;
 		goto recheck;
 	}
 
+	acct->stats.rq_depth_sum += depth;
+	acct->stats.rq_samples++;
+	if (choice != curr_task)
+		acct->stats.switches++;
+	acct->last_idle = (choice == idle);
+
 	return choice;
 }
 
+/*----------------------------------------*
+ *  published snapshot for the query path *
+ *----------------------------------------*/
+
+/*
+ * query calls read a published copy of the pset table instead of taking
+ * psetlist_lock, so monitoring traffic on many CPUs never bounces the lock
+ * or waits out a reconfiguration.  writers hold psetlist_lock for writing
+ * and bracket every change with pset_snap_begin/pset_snap_end.  readers
+ * copy what they need and retry if the sequence was odd or moved under
+ * them.  more than PSET_SNAP_MAX sets falls back to the locked list.
+ */
+#define PSET_SNAP_MAX	64
+
+typedef struct pset_snap_entry {
+	struct sched_policy *ptr;	/* compared, never followed */
+	psetid_t        id;
+	int             spu_count;
+	unsigned long   spus;
+	pset_attrval_t  non_empty_op;
+	int             min_spus;
+	int             max_spus;
+} pset_snap_entry_t;
+
+static struct pset_snap {
+	volatile unsigned int seq;
+	int               count;            /* PSET_SNAP_MAX + 1 if overflowed */
+	psetid_t          pset_of_cpu[NR_CPUS];
+	pset_snap_entry_t entry[PSET_SNAP_MAX];  /* sorted by id */
+} pset_snap ____cacheline_aligned;
+
+static inline void
+pset_snap_fill(struct sched_policy *pset_ptr, pset_snap_entry_t *out)
+{
+	out->ptr = pset_ptr;
+	out->id = PSET_PRIV(pset_ptr)->ps_id;
+	out->spu_count = PSET_PRIV(pset_ptr)->ps_spu_count;
+	out->spus = PSET_PRIV(pset_ptr)->ps_cpus_allowed;
+	out->non_empty_op = PSET_PRIV(pset_ptr)->ps_non_empty_op;
+	out->min_spus = PSET_PRIV(pset_ptr)->ps_min_spus;
+	out->max_spus = PSET_PRIV(pset_ptr)->ps_max_spus;
+}
+
+static inline void
+pset_snap_begin(void)
+{
+	pset_snap.seq++;
+	wmb();
+}
+
+static void
+pset_snap_end(void)
+{
+	/* republish the whole table, psetlist_lock held for writing */
+	struct sched_policy *pset_ptr;
+	int i = 0, cpu;
+
+	for (pset_ptr = default_pset; pset_ptr; pset_ptr = PSET_PRIV(pset_ptr)->ps_next){
+		if (i < PSET_SNAP_MAX)
+			pset_snap_fill(pset_ptr, &pset_snap.entry[i]);
+		i++;
+	}
+	pset_snap.count = (i > PSET_SNAP_MAX) ? PSET_SNAP_MAX + 1 : i;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++){
+		if (pset_of_cpu[cpu])
+			pset_snap.pset_of_cpu[cpu] = PSET_PRIV(pset_of_cpu[cpu])->ps_id;
+		else pset_snap.pset_of_cpu[cpu] = PS_DEFAULT;
+	}
+
+	wmb();
+	pset_snap.seq++;
+}
+
+static inline unsigned int
+pset_snap_read_begin(void)
+{
+	unsigned int seq;
+
+	while ((seq = pset_snap.seq) & 1)
+		barrier();
+	rmb();
+	return seq;
+}
+
+static inline int
+pset_snap_read_retry(unsigned int seq)
+{
+	rmb();
+	return (pset_snap.seq != seq);
+}
+
+/*------------------------------*
+ *  load driven cpu rebalancing *
+ *------------------------------*/
+
+/*
+ * optional.  every pset_balance_ms we sample the runnable tasks of each
+ * set and let pset_balance_pick decide whether one cpu should move from
+ * an idle set to a busy one, within the PSET_ATTR_MINSPUS/MAXSPUS bounds
+ * of both.  the decision logic lives in pset_balance.h so it can be run
+ * in user space too.
+ */
+static int pset_balance_ms = 0;		/* 0 leaves cpus where users put them */
+MODULE_PARM(pset_balance_ms, "i");
+
+static pset_balancer_t pset_balancer;
+static struct timer_list pset_balance_timer;
+static struct tq_struct pset_balance_tq;
+static int pset_balance_stopping = 0;
+
+static void
+pset_balance(void *unused)
+{
+	/* runs from keventd, since moving a cpu can sleep */
+	pset_balance_set_t set[PSET_SNAP_MAX];
+	unsigned long spus[PSET_SNAP_MAX];
+	struct sched_policy *pset_ptr;
+	struct list_head *tmp;
+	int n = 0, d, r, cpu;
+	psetid_t opset;
+
+       	read_lock(&psetlist_lock);
+	spin_lock_irq(&runqueue_lock);
+	pset_sort_runqueue();
+	for (pset_ptr = default_pset; pset_ptr && (n < PSET_SNAP_MAX);
+	     pset_ptr = PSET_PRIV(pset_ptr)->ps_next){
+		processor_set_priv_t *priv = PSET_PRIV(pset_ptr);
+		int runnable = 0;
+
+		list_for_each(tmp, &priv->ps_runqueue)
+			runnable++;
+		priv->ps_load = pset_load_decay(priv->ps_load, runnable);
+
+		set[n].id = priv->ps_id;
+		set[n].spu_count = priv->ps_spu_count;
+		set[n].min_spus = priv->ps_min_spus;
+		set[n].max_spus = priv->ps_max_spus;
+		set[n].is_default = (pset_ptr == default_pset);
+		set[n].load = priv->ps_load;
+		spus[n] = priv->ps_cpus_allowed;
+		n++;
+	}
+	spin_unlock_irq(&runqueue_lock);
+       	read_unlock(&psetlist_lock);
+
+	if (pset_balance_pick(&pset_balancer, set, n, &d, &r)){
+		/* hand over the highest numbered cpu of the donor */
+		for (cpu = NR_CPUS - 1; cpu >= 0; cpu--){
+			if (spus[d] & (1UL << cpu))
+				break;
+		}
+		/* sets may have changed since the sample, so errors are fine */
+		if (cpu >= 0)
+			pset_assign_spu(set[r].id, cpu, &opset);
+	}
+
+	if (!pset_balance_stopping)
+		mod_timer(&pset_balance_timer, jiffies + (pset_balance_ms * HZ) / 1000 + 1);
+}
+
+static void
+pset_balance_tick(unsigned long unused)
+{
+	schedule_task(&pset_balance_tq);
+}
+
 /*-------------------------------*
  *  load/unload module routines  *
  *-------------------------------*/
@@ -186,8 +501,11 @@ pset_init(void)
 
 	PSET_PRIV(new)->ps_id = PS_DEFAULT;
 	PSET_PRIV(new)->ps_non_empty_op = PSET_ATTRVAL_FAILBUSY;
+	PSET_PRIV(new)->ps_min_spus = 1;
+	PSET_PRIV(new)->ps_max_spus = NR_CPUS;
 	PSET_PRIV(new)->ps_spu_count = NR_CPUS;
         PSET_PRIV(new)->ps_cpus_allowed = 0;
+	INIT_LIST_HEAD(&PSET_PRIV(new)->ps_runqueue);
 
 	default_pset = new;
 
@@ -220,6 +538,9 @@ pset_init(void)
 	PSET_PRIV(default_pset)->ps_spu_count = limit;
 	psets_active = 1;
 
+	pset_snap_begin();
+	pset_snap_end();
+
 	return rc;
 }
 
@@ -227,16 +548,38 @@ pset_init(void)
 int
 init_module(void)
 {
-	return pset_init( );
+	int rc = pset_init( );
+
+	if (!rc && (pset_balance_ms > 0)){
+		INIT_TQUEUE(&pset_balance_tq, pset_balance, NULL);
+		init_timer(&pset_balance_timer);
+		pset_balance_timer.function = pset_balance_tick;
+		mod_timer(&pset_balance_timer, jiffies + (pset_balance_ms * HZ) / 1000 + 1);
+	}
+	return rc;
 }
 
 void
 cleanup_module(void)
 {
+	/* the rebalancer re-arms itself, so stop it before and after a flush */
+	if (pset_balance_ms > 0){
+		pset_balance_stopping = 1;
+		del_timer_sync(&pset_balance_timer);
+		flush_scheduled_tasks();
+		del_timer_sync(&pset_balance_timer);
+	}
+
 	/* prevent new creations while we deassemble the module */
 	write_lock_irq(&psetlist_lock);
 
 	unregister_sched(PSET_VERSION);
+
+	/* give bound runnables back to the stock scheduler */
+	spin_lock(&runqueue_lock);
+	list_splice(&PSET_PRIV(default_pset)->ps_runqueue, &runqueue_head);
+	spin_unlock(&runqueue_lock);
+
 	kfree (default_pset);
 	default_pset = NULL;
 	psets_active = 0;
@@ -276,6 +619,7 @@ pset_create ( psetid_t *pset )
 	new->sp_preemptability = default_pset->sp_preemptability;
 
         write_lock_irq(&psetlist_lock);
+	pset_snap_begin();
 
 	curr_pset = default_pset;
 	next = PSET_PRIV(curr_pset)->ps_next;
@@ -293,7 +637,10 @@ pset_create ( psetid_t *pset )
 	/* initialize private */
 	PSET_PRIV(new)->ps_id = PSET_PRIV(curr_pset)->ps_id + 1;
 	PSET_PRIV(new)->ps_non_empty_op = PSET_ATTRVAL_DFLTPSET;
+	PSET_PRIV(new)->ps_min_spus = 0;
+	PSET_PRIV(new)->ps_max_spus = NR_CPUS;
 	PSET_PRIV(new)->ps_spu_count = 0;
+	INIT_LIST_HEAD(&PSET_PRIV(new)->ps_runqueue);
 
 	/* insert into sorted list */
 	PSET_PRIV(new)->ps_next = next;
@@ -310,6 +657,7 @@ pset_create ( psetid_t *pset )
 		pset_busy = 1;
 	}
 #endif
+	pset_snap_end();
 	write_unlock_irq(&psetlist_lock);
 	return retval;
 }
@@ -335,6 +683,7 @@ pset_destroy ( psetid_t pset )
 		return -EINVAL;
 
         write_lock_irq(&psetlist_lock);
+	pset_snap_begin();
 	curr_pset = default_pset;
 
 	/* look for a specific id */
@@ -364,6 +713,7 @@ pset_destroy ( psetid_t pset )
 
 			if (retval){
 				/* don't remove if process move failed */
+				pset_snap_end();
 				write_unlock_irq(&psetlist_lock);
 				return retval;
 			}
@@ -413,11 +763,21 @@ pset_destroy ( psetid_t pset )
 
         		for (i = 0; i < smp_num_cpus; i++) {
 				cpu = cpu_logical_map(i);
-				if (pset_of_cpu[cpu] == curr_pset)
+				if (pset_of_cpu[cpu] == curr_pset){
+					spin_lock(&runqueue_lock);
+					pset_acct_retire(cpu, NULL);
+					spin_unlock(&runqueue_lock);
 					pset_of_cpu[cpu]= default_pset;
+				}
 			}
 		}
 #endif
+		/* runnables just moved to default must leave our run queue */
+		spin_lock(&runqueue_lock);
+		list_splice(&PSET_PRIV(curr_pset)->ps_runqueue, &runqueue_head);
+		INIT_LIST_HEAD(&PSET_PRIV(curr_pset)->ps_runqueue);
+		spin_unlock(&runqueue_lock);
+
 		/* remove from pset list */
 
 		if (PSET_PRIV(curr_pset)->ps_next)
@@ -435,6 +795,7 @@ pset_destroy ( psetid_t pset )
 #endif
 	} else retval = -ESRCH;
 
+	pset_snap_end();
 	write_unlock_irq(&psetlist_lock);
 	return retval;
 }
@@ -456,44 +817,143 @@ find_pset(psetid_t ps_id)
 }
 
 static inline int
-find_spu(int id, struct sched_policy *pset_ptr)
+find_spu(int id, unsigned long spus)
 {
 #ifdef CONFIG_SMP
-	int i, cpu, choice = INT_MAX;
+	int cpu;
 	/* 
-	 * given a pset, and a previous CPU in that set, return the next
-         * sequentially ordered logical CPU number in the set.
-         * psetlist_lock should be locked to avoid changes to pset_of_cpu.
+	 * given the cpu mask of a pset, and a previous CPU in that set,
+	 * return the next sequentially ordered logical CPU number in the set.
 	 * EAGAIN means there are no more processors left, don't call again.
          */
-        for (i = 0; i < smp_num_cpus; i++) {
-		cpu = cpu_logical_map(i);
-		if ((cpu > id) && (cpu < choice) &&
-		   (pset_of_cpu[cpu] == pset_ptr))
-			choice = cpu;
-	}
-	if (choice < INT_MAX)
-		return choice;
+	if (id < -1)
+		id = -1;
+	if (id + 1 >= NR_CPUS)
+		return -EAGAIN;
+
+	cpu = find_next_bit(&spus, NR_CPUS, id + 1);
+	if (cpu < NR_CPUS)
+		return cpu;
 #else
-	if ((id <0) && (pset_of_cpu[0] == pset_ptr))
+	if ((id <0) && (spus & 1))
 		return 0;
 #endif
 	return -EAGAIN;
 }
 
+static int
+pset_snap_find(psetid_t ps_id, int next, pset_snap_entry_t *out)
+{
+	/*
+	 * copy out the published entry for ps_id, or with next set the
+	 * first pset numbered above it, without taking psetlist_lock.
+	 * only asks the locked list when the table overflowed the snapshot.
+	 */
+	struct sched_policy *pset_ptr;
+	unsigned int seq;
+	int lo, hi, mid, retval;
+
+	for (;;){
+		seq = pset_snap_read_begin();
+		if (pset_snap.count > PSET_SNAP_MAX)
+			break;
+
+		/* binary search for the first entry >= (or > for next) ps_id */
+		lo = 0;
+		hi = pset_snap.count;
+		while (lo < hi){
+			mid = (lo + hi) / 2;
+			if ((pset_snap.entry[mid].id < ps_id) ||
+			    (next && (pset_snap.entry[mid].id == ps_id)))
+				lo = mid + 1;
+			else hi = mid;
+		}
+
+		retval = -ESRCH;
+		if ((lo < pset_snap.count) &&
+		    (next || (pset_snap.entry[lo].id == ps_id))){
+			*out = pset_snap.entry[lo];
+			retval = 0;
+		}
+		if (!pset_snap_read_retry(seq))
+			return retval;
+	}
+
+       	read_lock(&psetlist_lock);
+	if (next){
+        	pset_ptr = default_pset;
+        	while (pset_ptr && (PSET_PRIV(pset_ptr)->ps_id <= ps_id))
+                	pset_ptr = PSET_PRIV(pset_ptr)->ps_next;
+	} else pset_ptr = find_pset(ps_id);
+
+	retval = -ESRCH;
+	if (pset_ptr){
+		pset_snap_fill(pset_ptr, out);
+		retval = 0;
+	}
+       	read_unlock(&psetlist_lock);
+	return retval;
+}
+
+static int
+pset_snap_current(void)
+{
+	/*
+	 * the id of the caller's set, looked up in the snapshot by its
+	 * pointer.  a destroy may move us and free our old set while we
+	 * look, so the pointer is only compared, never followed: a stale
+	 * one can't match, since the move and the free happen between
+	 * pset_snap_begin and pset_snap_end and so force a retry.
+	 * past PSET_SNAP_MAX sets it asks the locked list like the rest.
+	 */
+	struct sched_policy *pset_ptr;
+	unsigned int seq;
+	int i, retval;
+
+	for (;;){
+		seq = pset_snap_read_begin();
+		if (pset_snap.count > PSET_SNAP_MAX)
+			break;
+
+		pset_ptr = current->alt_policy;
+		retval = -ESRCH;
+		for (i = 0; i < pset_snap.count; i++){
+			if (pset_snap.entry[i].ptr == pset_ptr){
+				retval = pset_snap.entry[i].id;
+				break;
+			}
+		}
+		if (!pset_snap_read_retry(seq))
+			return retval;
+	}
+
+	read_lock(&psetlist_lock);
+	retval = PSET_PRIV(current->alt_policy)->ps_id;
+	read_unlock(&psetlist_lock);
+	return retval;
+}
+
 static int 
 pset_assign ( psetid_t pset, int spu, psetid_t* opset)
 {
 	/* put a CPU into a pset, and return the old membership/error */
 
+	if ((pset != PS_QUERY) && !PERMITTED())
+                return -EPERM;
+
+	return pset_assign_spu(pset, spu, opset);
+}
+
+static int
+pset_assign_spu ( psetid_t pset, int spu, psetid_t* opset)
+{
+	/* pset_assign once permission is settled, also used by pset_balance */
+
 #ifdef CONFIG_SMP
 	struct sched_policy *curr_pset;
 	int retval = 0, i;
 #endif
 
-	if ((pset != PS_QUERY) && !PERMITTED())
-                return -EPERM;
-
 	if ((pset < PS_QUERY) || (pset > max_ps_id))
 		return -EINVAL;
 
@@ -521,6 +981,7 @@ pset_assign ( psetid_t pset, int spu, psetid_t* opset)
 		return -EBUSY;
 
        	write_lock_irq(&psetlist_lock);
+	pset_snap_begin();
 	curr_pset = find_pset(pset);
 	if (curr_pset){
 		*opset = PSET_PRIV(pset_of_cpu[spu])->ps_id;
@@ -533,6 +994,10 @@ pset_assign ( psetid_t pset, int spu, psetid_t* opset)
 
 			/* do the accounting */
 			old_ptr = pset_of_cpu[spu];
+			spin_lock(&runqueue_lock);
+			pset_acct_retire(spu, old_ptr);
+			spin_unlock(&runqueue_lock);
+
                         PSET_PRIV(old_ptr)->ps_spu_count--;
                         PSET_PRIV(old_ptr)->ps_cpus_allowed &= (~mask);
                         old_allowed = PSET_PRIV(old_ptr)->ps_cpus_allowed;
@@ -557,6 +1022,7 @@ pset_assign ( psetid_t pset, int spu, psetid_t* opset)
 			resched_cpu(spu);
 		}
 	} else retval = -ESRCH;
+	pset_snap_end();
        	write_unlock_irq(&psetlist_lock);
 
 	return retval;
@@ -581,8 +1047,16 @@ pset_move(struct task_struct *p, struct sched_policy *newpolicy)
  	 * you must forfeit all rights to time on the current set.  
  	 * if the new set has no member cpus, you effectively freeze.
  	 */
+	unsigned long flags;
+
 	if (p->alt_policy != newpolicy){
         	p->alt_policy = newpolicy; /* must come before resched! */
+
+		/* leave the run queue of the old set */
+		spin_lock_irqsave(&runqueue_lock, flags);
+		pset_requeue(p);
+		spin_unlock_irqrestore(&runqueue_lock, flags);
+
 #ifdef CONFIG_SMP
  		p->cpus_allowed = PSET_PRIV(newpolicy)->ps_cpus_allowed;
 
@@ -622,7 +1096,7 @@ pset_bind ( psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset)
 		return retval;
         }
 
-	/* note: we ignore opset for all but PID type */
+	/* note: we ignore opset for all but PID and TGID types */
 
 	if (!PERMITTED())
                 return -EPERM;
@@ -644,8 +1118,18 @@ pset_bind ( psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset)
 			if (id == PS_MYID)
 				id = current->pid;
 			break;
+		case P_TGID:
+			if (id == PS_MYID)
+				id = current->tgid;
+			break;
+		case P_UID:
+			if (id == PS_MYID)
+				id = current->uid;
+			/* like pgrp 0 and 1, moving every root task is refused */
+			if (id == 0)
+				return -EPERM;
+			break;
 		default:
-			/* LATER, implement THREAD and UID */
 			return -EINVAL;
 	}
 
@@ -657,18 +1141,41 @@ pset_bind ( psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset)
         	read_lock(&tasklist_lock);
 		switch(idtype){
 		case P_PGID:
+			/*
+			 * 2.4 chains tasks by pid only, and a module never sees
+			 * setpgid, so there is no group index we could trust.
+			 */
         		for_each_task(p){
 				if (p->pgrp == id)
 					retval = pset_move (p, curr_pset);
 			}
 			break;
-		default:
-		case P_PID:
+		case P_UID:
+			/* same story for uid, user_struct keeps no task list */
         		for_each_task(p){
-				if (p->pid == id){
-					*opset = PSET_PRIV(p->alt_policy)->ps_id;
+				if (p->uid == id)
 					retval = pset_move (p, curr_pset);
-				}
+			}
+			break;
+		case P_TGID:
+			/* the kernel already links the threads of a process */
+			p = find_task_by_pid(id);
+			if (p && (p->tgid == id)){
+				struct list_head *tmp;
+
+				*opset = PSET_PRIV(p->alt_policy)->ps_id;
+				retval = pset_move (p, curr_pset);
+				list_for_each(tmp, &p->thread_group)
+					pset_move (list_entry(tmp, struct task_struct,
+						thread_group), curr_pset);
+			}
+			break;
+		default:
+		case P_PID:
+			p = find_task_by_pid(id);
+			if (p){
+				*opset = PSET_PRIV(p->alt_policy)->ps_id;
+				retval = pset_move (p, curr_pset);
 			}
 			break;
 		}
@@ -679,13 +1186,67 @@ pset_bind ( psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset)
 	return retval;
 }
 
+static int
+pset_bindv ( psetid_t pset, int count, id_t *pids, psetid_t *opsets, int *errors)
+{
+	/*
+	 * put a vector of tasks into a pset under one hold of the locks.
+	 * each pid gets its old membership and error code in opsets/errors.
+	 * returns the number of tasks bound, or an error for the whole call.
+	 */
+
+	struct sched_policy *curr_pset;
+	int i, moved = 0;
+        struct task_struct *p;
+
+	if (!PERMITTED())
+                return -EPERM;
+
+	if ((pset < PS_DEFAULT) || (pset > max_ps_id))
+		return -EINVAL;
+
+        read_lock(&psetlist_lock);
+        curr_pset = find_pset(pset);
+	if (!curr_pset){
+        	read_unlock(&psetlist_lock);
+		return -ESRCH;
+	}
+
+        read_lock(&tasklist_lock);
+	for (i = 0; i < count; i++){
+		id_t id = pids[i];
+
+		opsets[i] = PS_NONE;
+		if (id == PS_MYID)
+			id = current->pid;
+		if (id < 0){
+			errors[i] = -EINVAL;
+			continue;
+		}
+
+		p = find_task_by_pid(id);
+		if (!p){
+			errors[i] = -ESRCH;
+			continue;
+		}
+		opsets[i] = PSET_PRIV(p->alt_policy)->ps_id;
+		errors[i] = pset_move (p, curr_pset);
+		if (!errors[i])
+			moved++;
+	}
+        read_unlock(&tasklist_lock);
+        read_unlock(&psetlist_lock);
+
+	return moved;
+}
+
 static int 
 pset_getattr ( psetid_t pset, pset_attrtype_t type, pset_attrval_t* value)
 {
 	/* look up the specified attribute of the indicated pset */
 
-	struct sched_policy *curr_pset;
-	int retval = 0;
+	pset_snap_entry_t ps;
+	int retval;
 
 	if ((pset < PS_DEFAULT) || (pset >= max_ps_id))
 		return -EINVAL;
@@ -693,15 +1254,18 @@ pset_getattr ( psetid_t pset, pset_attrtype_t type, pset_attrval_t* value)
 	if (!value)
 		return -EFAULT;
 
-	if (type != PSET_ATTR_NONEMPTY)
+	if ((type != PSET_ATTR_NONEMPTY) && (type != PSET_ATTR_MINSPUS) &&
+	    (type != PSET_ATTR_MAXSPUS))
 		return -EINVAL;
 
-       	read_lock(&psetlist_lock);
-	curr_pset = find_pset(pset);
-	if (curr_pset)
-		*value = PSET_PRIV(curr_pset)->ps_non_empty_op;
-	else retval = -ESRCH;
-       	read_unlock(&psetlist_lock);
+	retval = pset_snap_find(pset, 0, &ps);
+	if (!retval){
+		if (type == PSET_ATTR_MINSPUS)
+			*value = ps.min_spus;
+		else if (type == PSET_ATTR_MAXSPUS)
+			*value = ps.max_spus;
+		else *value = ps.non_empty_op;
+	}
 
 	return retval;
 }
@@ -717,22 +1281,45 @@ pset_setattr ( psetid_t pset, pset_attrtype_t type, pset_attrval_t value)
 	if (!PERMITTED())
                 return -EPERM;
 
-	/* prevents change of 0 */
-	if ((pset <= PS_DEFAULT) || (pset > max_ps_id))
-		return -EINVAL;
-
-	if (type != PSET_ATTR_NONEMPTY)
+	if ((pset < PS_DEFAULT) || (pset > max_ps_id))
 		return -EINVAL;
 
-	if ((value < PSET_ATTRVAL_FAILBUSY) || (value > PSET_ATTRVAL_KILL))
+	switch(type){
+	case PSET_ATTR_NONEMPTY:
+		/* prevents change of 0 */
+		if (pset == PS_DEFAULT)
+			return -EINVAL;
+		if ((value < PSET_ATTRVAL_FAILBUSY) || (value > PSET_ATTRVAL_KILL))
+			return -EINVAL;
+		break;
+	case PSET_ATTR_MINSPUS:
+	case PSET_ATTR_MAXSPUS:
+		/* value is a cpu count for these */
+		if (((int)value < 0) || ((int)value > NR_CPUS))
+			return -EINVAL;
+		break;
+	default:
 		return -EINVAL;
+	}
 
-       	read_lock(&psetlist_lock);
+       	write_lock_irq(&psetlist_lock);
+	pset_snap_begin();
 	curr_pset = find_pset(pset);
-	if (curr_pset)
-		PSET_PRIV(curr_pset)->ps_non_empty_op = value;
-	else retval = -ESRCH;
-       	read_unlock(&psetlist_lock);
+	if (!curr_pset)
+		retval = -ESRCH;
+	else if (type == PSET_ATTR_MINSPUS){
+		/* the default set always keeps its last cpu */
+		if (((int)value > PSET_PRIV(curr_pset)->ps_max_spus) ||
+		    ((pset == PS_DEFAULT) && ((int)value < 1)))
+			retval = -EINVAL;
+		else PSET_PRIV(curr_pset)->ps_min_spus = value;
+	} else if (type == PSET_ATTR_MAXSPUS){
+		if ((int)value < PSET_PRIV(curr_pset)->ps_min_spus)
+			retval = -EINVAL;
+		else PSET_PRIV(curr_pset)->ps_max_spus = value;
+	} else PSET_PRIV(curr_pset)->ps_non_empty_op = value;
+	pset_snap_end();
+       	write_unlock_irq(&psetlist_lock);
 
 	return retval;
 }
@@ -740,10 +1327,15 @@ pset_setattr ( psetid_t pset, pset_attrtype_t type, pset_attrval_t value)
 static int
 pset_ctl ( pset_request_t req, psetid_t pset, id_t id)
 {
-	/* look up a wide range of information about pset, CPU, or own task */
+	/*
+	 * look up a wide range of information about pset, CPU, or own task.
+	 * everything here reads the published snapshot, never psetlist_lock,
+	 * but our own set, which lives outside the snapshot.
+	 */
 
 	int retval = -EINVAL;
-	struct sched_policy *pset_ptr;
+	pset_snap_entry_t ps;
+	unsigned int seq;
 
 	switch(req){
         case PSET_GETNUMPSETS: 
@@ -755,49 +1347,31 @@ pset_ctl ( pset_request_t req, psetid_t pset, id_t id)
 		break;
 
         case PSET_GETNEXTPSET:
-       		read_lock(&psetlist_lock);
-        	pset_ptr = default_pset;
-        	while (pset_ptr){
-                	if (PSET_PRIV(pset_ptr)->ps_id > pset)
-                        	break;
-                	pset_ptr = PSET_PRIV(pset_ptr)->ps_next;
-        	}
-		if (!pset_ptr)
-			retval = -ESRCH;
-		else retval = PSET_PRIV(pset_ptr)->ps_id;
-       		read_unlock(&psetlist_lock);
+		retval = pset_snap_find(pset, 1, &ps);
+		if (!retval)
+			retval = ps.id;
 		break;
 
         case PSET_GETCURRENTPSET:
-		retval = -ESRCH;
-		
-       		read_lock(&psetlist_lock);
-		retval = PSET_PRIV(current->alt_policy)->ps_id;
-       		read_unlock(&psetlist_lock);
+		retval = pset_snap_current();
 		break;
 
         case PSET_GETNUMSPUS:
-       		read_lock(&psetlist_lock);
-		pset_ptr = find_pset(pset);
-		if (pset_ptr){
-			retval = PSET_PRIV(pset_ptr)->ps_spu_count;
-		} else retval = -ESRCH;
-       		read_unlock(&psetlist_lock);
+		retval = pset_snap_find(pset, 0, &ps);
+		if (!retval)
+			retval = ps.spu_count;
 		break;
 	
         case PSET_GETFIRSTSPU:
 		id = -1;
 		/* fall through to PSET_GETNEXTSPU */
         case PSET_GETNEXTSPU:
-       		read_lock(&psetlist_lock);
-		pset_ptr = find_pset(pset);
-		if (!pset_ptr)
-			retval = -ESRCH;
-		else if (!PSET_PRIV(pset_ptr)->ps_spu_count)
+		retval = pset_snap_find(pset, 0, &ps);
+		if (retval)
+			break;
+		if (!ps.spu_count)
 			retval = -ENOENT;
-                else retval = find_spu(id, pset_ptr); 
-
-       		read_unlock(&psetlist_lock);
+                else retval = find_spu(id, ps.spus); 
 		break;
         case PSET_SPUTOPSET:
 #ifdef CONFIG_SMP
@@ -812,12 +1386,10 @@ pset_ctl ( pset_request_t req, psetid_t pset, id_t id)
 			if (i >= smp_num_cpus)
 				retval =  -EINVAL;
 			else {
-       				read_lock(&psetlist_lock);
-				pset_ptr = pset_of_cpu[id];
-				if (!pset_ptr)
-					retval = PS_DEFAULT;
-				else retval = PSET_PRIV(pset_ptr)->ps_id;
-       				read_unlock(&psetlist_lock);
+				do {
+					seq = pset_snap_read_begin();
+					retval = pset_snap.pset_of_cpu[id];
+				} while (pset_snap_read_retry(seq));
 			}
 		}
 #else
@@ -833,6 +1405,76 @@ pset_ctl ( pset_request_t req, psetid_t pset, id_t id)
 	return retval;
 }
 
+static int
+pset_getstats ( psetid_t pset, pset_stats_t *stats)
+{
+	/*
+	 * add up the usage counters of a pset.  the per cpu counters are
+	 * read without runqueue_lock, which can only make a sum a little
+	 * stale, never wrong, since they only grow between retirements.
+	 */
+	struct sched_policy *pset_ptr;
+	int retval = 0, cpu;
+
+	memset(stats, 0, sizeof(pset_stats_t));
+
+       	read_lock(&psetlist_lock);
+	pset_ptr = find_pset(pset);
+	if (pset_ptr){
+		*stats = PSET_PRIV(pset_ptr)->ps_retired;
+		for (cpu = 0; cpu < NR_CPUS; cpu++){
+			if (pset_of_cpu[cpu] == pset_ptr)
+				pset_stats_add(stats, &pset_acct[cpu].stats);
+		}
+	} else retval = -ESRCH;
+       	read_unlock(&psetlist_lock);
+
+	return retval;
+}
+
+static int
+pset_topology ( int room, pset_topology_entry_t **entries, int *count)
+{
+	/*
+	 * snapshot every pset and its member cpus in one pass.  the buffer
+	 * is kmalloc'ed here and freed by the caller after copy out.
+	 * *count is the number of psets, which may be more than room.
+	 */
+	struct sched_policy *pset_ptr;
+	pset_topology_entry_t *buf;
+	int n, i;
+
+	if (room < 0)
+		return -EINVAL;
+
+again:
+	n = psets_active;
+	buf = kmalloc(n * sizeof(pset_topology_entry_t), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	read_lock(&psetlist_lock);
+	if (psets_active > n){
+		/* somebody created a set while we slept in kmalloc */
+		read_unlock(&psetlist_lock);
+		kfree(buf);
+		goto again;
+	}
+
+	i = 0;
+	for (pset_ptr = default_pset; pset_ptr; pset_ptr = PSET_PRIV(pset_ptr)->ps_next){
+		buf[i].pset = PSET_PRIV(pset_ptr)->ps_id;
+		buf[i].spu_count = PSET_PRIV(pset_ptr)->ps_spu_count;
+		buf[i].spus = PSET_PRIV(pset_ptr)->ps_cpus_allowed;
+		i++;
+	}
+	read_unlock(&psetlist_lock);
+
+	*entries = buf;
+	*count = i;
+	return 0;
+}
+
 static int 
 pset_ioctl(struct inode * inode, struct file * file, unsigned int cmd, unsigned long arg)
 {
@@ -895,6 +1537,42 @@ pset_ioctl(struct inode * inode, struct file * file, unsigned int cmd, unsigned
 		break;
 		}
 
+	case PSIOC_BINDV:
+		{
+		pset_bindv_t tmp;
+		id_t *pids;
+		psetid_t *opsets;
+		int *errors;
+
+                if (copy_from_user(&tmp, (pset_bindv_t *)arg, sizeof(pset_bindv_t)))
+                	return -EFAULT;
+		if ((tmp.count <= 0) || (tmp.count > PSET_BINDV_MAX))
+			return -EINVAL;
+
+		pids = kmalloc(tmp.count * sizeof(id_t), GFP_KERNEL);
+		opsets = kmalloc(tmp.count * sizeof(psetid_t), GFP_KERNEL);
+		errors = kmalloc(tmp.count * sizeof(int), GFP_KERNEL);
+		if (!pids || !opsets || !errors)
+			retval = -ENOMEM;
+		else if (copy_from_user(pids, tmp.pids, tmp.count * sizeof(id_t)))
+			retval = -EFAULT;
+		else {
+			retval = pset_bindv(tmp.pset, tmp.count, pids, opsets, errors);
+			if (retval >= 0){
+				if (copy_to_user(tmp.opsets, opsets, tmp.count * sizeof(psetid_t)) ||
+				    copy_to_user(tmp.errors, errors, tmp.count * sizeof(int)))
+					retval = -EFAULT;
+			}
+		}
+		if (pids)
+			kfree(pids);
+		if (opsets)
+			kfree(opsets);
+		if (errors)
+			kfree(errors);
+		break;
+		}
+
 	case PSIOC_GETATTR:
 		{
 		pset_getattr_t tmp;
@@ -930,6 +1608,41 @@ pset_ioctl(struct inode * inode, struct file * file, unsigned int cmd, unsigned
 		break;
 		}
 
+	case PSIOC_GETSTATS:
+		{
+		pset_getstats_t tmp;
+		pset_stats_t output;
+
+                if (copy_from_user(&tmp, (pset_getstats_t *)arg, sizeof(pset_getstats_t)))
+                	return -EFAULT;
+		retval = pset_getstats(tmp.pset, &output);
+		if (!retval){
+			if (copy_to_user(tmp.stats, &output, sizeof(pset_stats_t)))
+				retval = -EFAULT;
+		}
+		break;
+		}
+
+	case PSIOC_TOPOLOGY:
+		{
+		pset_topology_t tmp;
+		pset_topology_entry_t *output;
+		int count;
+
+                if (copy_from_user(&tmp, (pset_topology_t *)arg, sizeof(pset_topology_t)))
+                	return -EFAULT;
+		retval = pset_topology(tmp.count, &output, &count);
+		if (!retval){
+			/* copy what fits, and tell the caller how much there was */
+			if (copy_to_user(tmp.entries, output,
+				(count < tmp.count ? count : tmp.count) * sizeof(pset_topology_entry_t)) ||
+			    put_user(count, &((pset_topology_t *)arg)->count))
+				retval = -EFAULT;
+			kfree(output);
+		}
+		break;
+		}
+
 	default:
 		retval = -EINVAL;
 		break;
@@ -17,7 +17,9 @@ typedef enum       /* matches /usr/include/sys/wait.h */
 {
   P_ALL,
   P_PID,
-  P_PGID
+  P_PGID,
+  P_TGID,          /* pset extension: every thread of a process */
+  P_UID            /* pset extension: every task of a user */
 } idtype_t;
 
 typedef enum pset_request {
@@ -50,7 +52,9 @@ typedef enum pset_attrtype {
         PSET_ATTR_IOINTR        = 4, /* unimplemented */
         PSET_ATTR_NONEMPTY      = 5,
         PSET_ATTR_EMPTY         = 6, /* unimplemented */
-        PSET_ATTR_LASTSPU       = 7  /* unimplemented */
+        PSET_ATTR_LASTSPU       = 7, /* unimplemented */
+        PSET_ATTR_MINSPUS       = 8, /* value is a cpu count */
+        PSET_ATTR_MAXSPUS       = 9  /* value is a cpu count */
 } pset_attrtype_t ;
 
 #define PSIOC_BASE      100
@@ -61,6 +65,11 @@ typedef enum pset_attrtype {
 #define PSIOC_GETATTR	5
 #define PSIOC_SETATTR   6
 #define PSIOC_CTL	7
+#define PSIOC_TOPOLOGY	8
+#define PSIOC_BINDV	9
+#define PSIOC_GETSTATS	10
+
+#define PSET_BINDV_MAX  4096    /* most pids in one PSIOC_BINDV */
 
 typedef psetid_t * pset_create_t;
 typedef psetid_t   pset_destroy_t;
@@ -78,6 +87,14 @@ typedef struct pset_bind_args {
         psetid_t *opset;
 } pset_bind_t;
 
+typedef struct pset_bindv_args {
+        psetid_t pset;
+        int      count;         /* entries in each of the arrays */
+        id_t     *pids;
+        psetid_t *opsets;       /* out: old set of each pid */
+        int      *errors;       /* out: 0 or -errno for each pid */
+} pset_bindv_t;
+
 typedef struct pset_getattr_args {
         psetid_t        pset;
         pset_attrtype_t type;
@@ -96,4 +113,29 @@ typedef struct pset_ctl_args {
         id_t     id;
 } pset_ctl_t;
 
+typedef struct pset_stats {
+        unsigned long run_ticks;     /* jiffies cpus of the set ran tasks */
+        unsigned long idle_ticks;    /* jiffies cpus of the set sat idle */
+        unsigned long switches;      /* dispatches that changed task */
+        unsigned long rq_depth_sum;  /* runnables seen, summed per dispatch */
+        unsigned long rq_samples;    /* dispatches, to average rq_depth_sum */
+        unsigned long recomputes;    /* times the set ran out of ticks */
+} pset_stats_t;
+
+typedef struct pset_getstats_args {
+        psetid_t     pset;
+        pset_stats_t *stats;
+} pset_getstats_t;
+
+typedef struct pset_topology_entry {
+        psetid_t      pset;
+        int           spu_count;
+        unsigned long spus;     /* bit per logical cpu in the set */
+} pset_topology_entry_t;
+
+typedef struct pset_topology_args {
+        int                   count;   /* in: room in entries, out: psets */
+        pset_topology_entry_t *entries;
+} pset_topology_t;
+
 #endif
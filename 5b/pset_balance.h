@@ -0,0 +1,117 @@
+#ifndef _SCHED_PSET_BALANCE_H
+#define _SCHED_PSET_BALANCE_H
+
+/*
+ * load driven cpu rebalancing between processor sets.
+ *
+ * This is only the decision: given the runnable load and cpu count of each
+ * set, which set should give a cpu to which.  It has no kernel dependencies
+ * so the pset module and the user space harness run the same code.
+ *
+ * Loads are runnable task counts in 1/PSET_LOAD_ONE fixed point, smoothed
+ * by the caller with pset_load_decay.  A move is only made when the busier
+ * set would still be busier per cpu after taking the cpu, by a margin, and
+ * when the same move has been wanted PSET_BALANCE_STREAK samples in a row.
+ * After a move the balancer sits out PSET_BALANCE_COOLDOWN samples.
+ */
+
+#define PSET_LOAD_SHIFT       8
+#define PSET_LOAD_ONE         (1 << PSET_LOAD_SHIFT)
+#define PSET_BALANCE_STREAK   3
+#define PSET_BALANCE_COOLDOWN 5
+#define PSET_BALANCE_MARGIN   5   /* receiver must be busier by 5/4 */
+
+typedef struct pset_balance_set {
+        int           id;
+        int           spu_count;
+        int           min_spus;
+        int           max_spus;
+        int           is_default;  /* must keep its last cpu */
+        unsigned long load;        /* smoothed runnables, fixed point */
+} pset_balance_set_t;
+
+typedef struct pset_balancer {
+        int donor;                 /* move wanted on the previous sample */
+        int receiver;
+        int streak;                /* samples in a row it was wanted */
+        int cooldown;              /* samples left to wait after a move */
+} pset_balancer_t;
+
+static inline unsigned long
+pset_load_decay(unsigned long load, int runnable)
+{
+	/* exponential average, each sample weighs a quarter */
+	return (load * 3 + ((unsigned long)runnable << PSET_LOAD_SHIFT)) / 4;
+}
+
+static inline int
+pset_balance_wanted(pset_balance_set_t *d, pset_balance_set_t *r)
+{
+	/*
+	 * would r still be busier per cpu than d after taking a cpu from it?
+	 * cross multiplied: r->load / (r + 1) > 5/4 * d->load / (d - 1).
+	 * a donor giving up its only cpu must have nothing to run.
+	 */
+	if (d->spu_count <= 1)
+		return (d->load == 0) && (r->load > 0);
+
+	return (r->load * (d->spu_count - 1) * 4 >
+		d->load * (r->spu_count + 1) * PSET_BALANCE_MARGIN);
+}
+
+static inline int
+pset_balance_pick(pset_balancer_t *b, pset_balance_set_t *set, int nsets,
+		  int *donor, int *receiver)
+{
+	/*
+	 * look at one load sample.  returns 1 and fills in the indexes of
+	 * the donor and receiver sets when a cpu should move now.
+	 */
+	int i, d = -1, r = -1;
+
+	if (b->cooldown > 0){
+		b->cooldown--;
+		return 0;
+	}
+
+	for (i = 0; i < nsets; i++){
+		pset_balance_set_t *s = &set[i];
+
+		/* busiest per cpu set that may grow: compare load / (count+1) */
+		if ((s->spu_count < s->max_spus) && s->load &&
+		    ((r < 0) || (s->load * (set[r].spu_count + 1) >
+				 set[r].load * (s->spu_count + 1))))
+			r = i;
+
+		/* idlest per cpu set that may shrink */
+		if ((s->spu_count > s->min_spus) &&
+		    !(s->is_default && (s->spu_count <= 1)) &&
+		    ((d < 0) || (s->load * set[d].spu_count <
+				 set[d].load * s->spu_count)))
+			d = i;
+	}
+
+	if ((d < 0) || (r < 0) || (d == r) || !pset_balance_wanted(&set[d], &set[r])){
+		b->streak = 0;
+		return 0;
+	}
+
+	/* hysteresis: the same move has to keep looking right */
+	if ((b->donor == set[d].id) && (b->receiver == set[r].id))
+		b->streak++;
+	else {
+		b->donor = set[d].id;
+		b->receiver = set[r].id;
+		b->streak = 1;
+	}
+	if (b->streak < PSET_BALANCE_STREAK)
+		return 0;
+
+	b->streak = 0;
+	b->cooldown = PSET_BALANCE_COOLDOWN;
+	*donor = d;
+	*receiver = r;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,475 @@
+/*
+ * pset_bench.c : user space harness for the processor set scheduler.
+ *
+ * Models the pick-next loop of pset_choose_task on a fake machine whose
+ * CPUs are split into processor sets of very different sizes, then times
+ * it two ways: the old single global run queue filtered by cpus_allowed,
+ * and one run queue per pset with lazy epoch based counter replenishment,
+ * as pset.c does now.  Nothing here touches the kernel; task and
+ * list structures are cut down to the fields the chooser looks at.
+ *
+ * The query mode times pset_ctl style lookups from many reader threads
+ * while one thread keeps reassigning cpus, once through a reader/writer
+ * lock and once through a sequence-checked snapshot like pset_snap.
+ *
+ * The balance mode feeds the rebalancer of pset_balance.h a load that
+ * shifts from one set to another, and shows where the cpus end up.
+ *
+ * usage: pset_bench [tasks] [rounds]
+ *        pset_bench query [readers] [seconds]
+ *        pset_bench balance [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pset_balance.h"
+
+#define NCPUS		8
+#define NPSETS		3
+#define NICE_TICKS	6	/* stands in for NICE_TO_TICKS(0) */
+#define IDLE_WEIGHT	-1
+
+/* cpus and share of runnable tasks for each pset, deliberately lopsided */
+static const int pset_cpus[NPSETS]  = { 5, 2, 1 };
+static const int pset_share[NPSETS] = { 90, 9, 1 };
+
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define list_entry(ptr, type, member) \
+	((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+#define list_for_each(pos, head) \
+	for (pos = (head)->next; pos != (head); pos = pos->next)
+
+static void
+list_init(struct list_head *h)
+{
+	h->next = h->prev = h;
+}
+
+static void
+list_add_tail(struct list_head *n, struct list_head *h)
+{
+	n->prev = h->prev;
+	n->next = h;
+	h->prev->next = n;
+	h->prev = n;
+}
+
+struct task {
+	int		counter;
+	int		pset;
+	int		has_cpu;
+	unsigned long	epoch;		/* last pset epoch it was refreshed in */
+	unsigned long	cpus_allowed;
+	struct list_head run_list;	/* global queue */
+	struct list_head pset_list;	/* per-pset queue */
+};
+
+static struct list_head runqueue_head;
+static struct list_head pset_runqueue[NPSETS];
+static unsigned long pset_mask[NPSETS];
+static int pset_of_cpu[NCPUS];
+static struct task *running[NCPUS];
+static unsigned long pset_epoch[NPSETS];
+static unsigned long epoch_seq;
+static long recomputes[2];
+
+#define is_visible(p, cpu) ((p)->cpus_allowed & (1UL << (cpu)))
+#define can_choose(p, cpu) (!(p)->has_cpu && is_visible(p, cpu))
+
+static struct task *
+choose_global(int this_cpu)
+{
+	/* the old way: every cpu walks every runnable task in the machine */
+	struct list_head *tmp;
+	struct task *p, *choice;
+	int high;
+
+recheck:
+	high = IDLE_WEIGHT;
+	choice = NULL;
+	list_for_each(tmp, &runqueue_head) {
+		p = list_entry(tmp, struct task, run_list);
+		if (can_choose(p, this_cpu) && p->counter > high) {
+			high = p->counter;
+			choice = p;
+		}
+	}
+	if (!high) {
+		recomputes[0]++;
+		list_for_each(tmp, &runqueue_head) {
+			p = list_entry(tmp, struct task, run_list);
+			if (is_visible(p, this_cpu))
+				p->counter = NICE_TICKS;
+		}
+		goto recheck;
+	}
+	return choice;
+}
+
+static struct task *
+choose_pset(int this_cpu)
+{
+	/* the new way: only the run queue of this cpu's pset, epoch refresh */
+	int ps = pset_of_cpu[this_cpu];
+	struct list_head *tmp, *rq = &pset_runqueue[ps];
+	struct task *p, *choice;
+	int high;
+
+recheck:
+	high = IDLE_WEIGHT;
+	choice = NULL;
+	list_for_each(tmp, rq) {
+		p = list_entry(tmp, struct task, pset_list);
+		if (p->epoch < pset_epoch[ps]) {
+			p->epoch = pset_epoch[ps];
+			p->counter = NICE_TICKS;
+		}
+		if (can_choose(p, this_cpu) && p->counter > high) {
+			high = p->counter;
+			choice = p;
+		}
+	}
+	if (!high) {
+		recomputes[1]++;
+		pset_epoch[ps] = ++epoch_seq;
+		goto recheck;
+	}
+	return choice;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run(const char *name, struct task *(*choose)(int), int rounds, long *recomp)
+{
+	/*
+	 * one tick per cpu per round: drop the running task, pick again and
+	 * charge the winner a tick.  report mean ns per pick for each pset.
+	 */
+	double spent[NPSETS] = { 0 };
+	long picks[NPSETS] = { 0 };
+	int r, cpu;
+
+	for (r = 0; r < rounds; r++) {
+		for (cpu = 0; cpu < NCPUS; cpu++) {
+			struct task *p;
+			double t0;
+
+			if (running[cpu])
+				running[cpu]->has_cpu = 0;
+			t0 = now();
+			p = choose(cpu);
+			spent[pset_of_cpu[cpu]] += now() - t0;
+			picks[pset_of_cpu[cpu]]++;
+			running[cpu] = p;
+			if (p) {
+				p->has_cpu = 1;
+				p->counter--;
+			}
+		}
+	}
+
+	printf("%-8s", name);
+	for (r = 0; r < NPSETS; r++)
+		printf("\t%10.1f", picks[r] ? spent[r] * 1e9 / picks[r] : 0.0);
+	printf("\t%10ld\n", *recomp);
+}
+
+/*-------------------------------------*
+ *  query path: rwlock versus snapshot  *
+ *-------------------------------------*/
+
+#define QPSETS		16
+
+struct qentry {
+	int		id;
+	int		spu_count;
+	unsigned long	spus;
+};
+
+static struct qentry qtable[QPSETS];		/* guarded by qlock */
+static pthread_rwlock_t qlock = PTHREAD_RWLOCK_INITIALIZER;
+
+static struct {
+	volatile unsigned int seq;
+	struct qentry entry[QPSETS];
+} qsnap __attribute__((aligned(64)));
+
+static volatile int qstop;
+static volatile int qsink;			/* keeps lookups from being optimized out */
+static int qsnapshot;				/* which path readers use */
+
+struct qreader {
+	long	lookups;
+	char	pad[64 - sizeof(long)];		/* keep counters apart */
+};
+
+static int
+qlookup_locked(int id)
+{
+	int n;
+
+	pthread_rwlock_rdlock(&qlock);
+	n = qtable[id].spu_count;
+	pthread_rwlock_unlock(&qlock);
+	return n;
+}
+
+static int
+qlookup_snap(int id)
+{
+	unsigned int seq;
+	int n;
+
+	do {
+		while ((seq = __atomic_load_n(&qsnap.seq, __ATOMIC_ACQUIRE)) & 1)
+			;
+		n = qsnap.entry[id].spu_count;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (qsnap.seq != seq);
+	return n;
+}
+
+static void *
+qreader_main(void *arg)
+{
+	struct qreader *me = arg;
+	unsigned int r = (unsigned long)arg;
+	long n = 0;
+	int sink = 0;
+
+	while (!qstop) {
+		r = r * 1103515245 + 12345;
+		sink += qsnapshot ? qlookup_snap((r >> 16) % QPSETS)
+				  : qlookup_locked((r >> 16) % QPSETS);
+		n++;
+	}
+	me->lookups = n;
+	qsink = sink;
+	return NULL;
+}
+
+static void *
+qwriter_main(void *arg)
+{
+	/* keep moving one cpu between two sets, like repeated pset_assign */
+	int from = 1, to = 2, t;
+
+	(void)arg;
+	while (!qstop) {
+		pthread_rwlock_wrlock(&qlock);
+		__atomic_store_n(&qsnap.seq, qsnap.seq + 1, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		qtable[from].spu_count--;
+		qtable[to].spu_count++;
+		memcpy(qsnap.entry, qtable, sizeof(qtable));
+		__atomic_store_n(&qsnap.seq, qsnap.seq + 1, __ATOMIC_RELEASE);
+		pthread_rwlock_unlock(&qlock);
+		t = from, from = to, to = t;
+		usleep(100);
+	}
+	return NULL;
+}
+
+static long
+qrun(int snapshot, int readers, int seconds)
+{
+	pthread_t writer, *tid;
+	struct qreader *stat;
+	long total = 0;
+	int i;
+
+	tid = calloc(readers, sizeof(pthread_t));
+	stat = calloc(readers, sizeof(struct qreader));
+	if (!tid || !stat) {
+		perror("calloc");
+		exit(1);
+	}
+
+	qstop = 0;
+	qsnapshot = snapshot;
+	pthread_create(&writer, NULL, qwriter_main, NULL);
+	for (i = 0; i < readers; i++)
+		pthread_create(&tid[i], NULL, qreader_main, &stat[i]);
+	sleep(seconds);
+	qstop = 1;
+	for (i = 0; i < readers; i++) {
+		pthread_join(tid[i], NULL);
+		total += stat[i].lookups;
+	}
+	pthread_join(writer, NULL);
+
+	free(tid);
+	free(stat);
+	return total / seconds;
+}
+
+static int
+query_bench(int argc, char **argv)
+{
+	int readers = argc > 2 ? atoi(argv[2]) : 8;
+	int seconds = argc > 3 ? atoi(argv[3]) : 2;
+	int i;
+
+	for (i = 0; i < QPSETS; i++) {
+		qtable[i].id = i;
+		qtable[i].spu_count = 4;
+	}
+	memcpy(qsnap.entry, qtable, sizeof(qtable));
+
+	printf("%d readers, 1 writer, lookups per second\n", readers);
+	printf("rwlock  \t%12ld\n", qrun(0, readers, seconds));
+	printf("snapshot\t%12ld\n", qrun(1, readers, seconds));
+	return 0;
+}
+
+/*----------------------------------*
+ *  rebalancer under a moving load  *
+ *----------------------------------*/
+
+#define BSETS		3
+
+static int
+balance_bench(int argc, char **argv)
+{
+	/*
+	 * 8 cpus: the default set plus two job sets.  the first third of
+	 * the run loads set 1, the middle third set 2, and the last third
+	 * both evenly with noise, where hysteresis should keep cpus still.
+	 */
+	int samples = argc > 2 ? atoi(argv[2]) : 300;
+	pset_balance_set_t set[BSETS] = {
+		{ 0, 4, 1, 8, 1, 0 },
+		{ 1, 2, 1, 6, 0, 0 },
+		{ 2, 2, 1, 6, 0, 0 },
+	};
+	pset_balancer_t b = { -1, -1, 0, 0 };
+	unsigned int r = 1;
+	long moves = 0;
+	double spent = 0;
+	int t, i, d, to;
+
+	printf("sample\tcpus(0,1,2)\tload(0,1,2)\n");
+	for (t = 0; t < samples; t++) {
+		int phase = t * 3 / samples;
+
+		for (i = 0; i < BSETS; i++) {
+			int runnable = 0;
+
+			r = r * 1103515245 + 12345;
+			if (i == 0)
+				runnable = (r >> 16) % 2;
+			else if ((phase == 0 && i == 1) || (phase == 1 && i == 2))
+				runnable = 24 + (r >> 16) % 8;
+			else if (phase == 2)
+				runnable = 10 + (r >> 16) % 5;
+			set[i].load = pset_load_decay(set[i].load, runnable);
+		}
+
+		{
+			double t0 = now();
+			int go = pset_balance_pick(&b, set, BSETS, &d, &to);
+
+			spent += now() - t0;
+			if (go) {
+				set[d].spu_count--;
+				set[to].spu_count++;
+				moves++;
+			}
+		}
+
+		if ((t + 1) % (samples / 6) == 0)
+			printf("%d\t%d %d %d\t\t%lu %lu %lu\n", t + 1,
+			       set[0].spu_count, set[1].spu_count, set[2].spu_count,
+			       set[0].load >> PSET_LOAD_SHIFT,
+			       set[1].load >> PSET_LOAD_SHIFT,
+			       set[2].load >> PSET_LOAD_SHIFT);
+	}
+	printf("%ld moves, %.1f ns per decision\n", moves, spent * 1e9 / samples);
+	return 0;
+}
+
+/*---------------------------*
+ *  pick-next: queue layout  *
+ *---------------------------*/
+
+static int
+choose_bench(int argc, char **argv)
+{
+	int ntasks = argc > 1 ? atoi(argv[1]) : 2000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+	struct task *tasks;
+	int i, cpu = 0, ps;
+
+	tasks = calloc(ntasks, sizeof(struct task));
+	if (!tasks) {
+		perror("calloc");
+		return 1;
+	}
+
+	list_init(&runqueue_head);
+	for (ps = 0; ps < NPSETS; ps++) {
+		list_init(&pset_runqueue[ps]);
+		for (i = 0; i < pset_cpus[ps]; i++, cpu++) {
+			pset_of_cpu[cpu] = ps;
+			pset_mask[ps] |= 1UL << cpu;
+		}
+	}
+
+	/* hand out tasks by share, interleaved so the global queue is mixed */
+	for (i = 0; i < ntasks; i++) {
+		int pick = i % 100;
+
+		for (ps = 0; pick >= pset_share[ps]; ps++)
+			pick -= pset_share[ps];
+		tasks[i].pset = ps;
+		tasks[i].cpus_allowed = pset_mask[ps];
+		tasks[i].counter = NICE_TICKS;
+		list_add_tail(&tasks[i].run_list, &runqueue_head);
+		list_add_tail(&tasks[i].pset_list, &pset_runqueue[ps]);
+	}
+
+	printf("%d tasks, %d rounds, ns per pick\n", ntasks, rounds);
+	printf("queue   ");
+	for (ps = 0; ps < NPSETS; ps++)
+		printf("\tpset %d (%d)", ps, pset_cpus[ps]);
+	printf("\trecomputes\n");
+
+	run("global", choose_global, rounds, &recomputes[0]);
+	for (i = 0; i < NCPUS; i++) {
+		if (running[i])
+			running[i]->has_cpu = 0;
+		running[i] = NULL;
+	}
+	for (i = 0; i < ntasks; i++)
+		tasks[i].counter = NICE_TICKS;
+	run("per-pset", choose_pset, rounds, &recomputes[1]);
+
+	free(tasks);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "query"))
+		return query_bench(argc, argv);
+	if (argc > 1 && !strcmp(argv[1], "balance"))
+		return balance_bench(argc, argv);
+	return choose_bench(argc, argv);
+}
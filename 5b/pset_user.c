@@ -0,0 +1,1092 @@
+/*
+ * pset_user.c : HP processor sets in user space, on cpu affinity.
+ *
+ * The pset module needs the altpolicy hooks of a 2.4 kernel.  This file
+ * gives the same calls on any Linux, doing by hand what pset.c does to
+ * cpus_allowed: every task of a set gets the cpus of its set as affinity
+ * mask, and every change to a set is pushed to all of its tasks.
+ *
+ * There is no alt_policy to tag a task with, so membership is read back
+ * from the mask itself.  A task whose mask is exactly the cpus of some
+ * non-default set is in that set, anything else is in the default set.
+ * Masks are copied at fork and clone like alt_policy was, so children
+ * and new threads stay in the set of their parent with no help from us.
+ * A task that pins itself to the very cpus of a set joins it.
+ *
+ * A set with no cpus has no mask to give.  The module freezes its tasks
+ * by zeroing counter; here they are remembered by tid and start time in
+ * the state file and their process gets SIGSTOP, then SIGCONT when the
+ * set gains a cpu or they leave it.  A stop always hits a whole process.
+ *
+ * The sets live in a state file, PSET_USER_STATE or $PSET_STATE, taken
+ * with flock: shared for queries, exclusive for changes, so several
+ * tools can share it.  It starts out as one default set of the online
+ * cpus.  Write access to the file stands in for PERMITTED().
+ *
+ * build with -DPSET_USER_MAIN for a small command line front end.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+
+#include "pset_user.h"
+
+#define PSET_USER_MAGIC 0x70736574
+#define PSET_USER_SETS  64       /* sets, the default one included */
+#define PSET_USER_PINS  4096     /* frozen tasks, and stopped processes */
+#define PF_KTHREAD      0x00200000
+
+/* internal structures */
+typedef struct pset_user_set {
+	psetid_t	ps_id;
+	int		ps_spu_count;
+	cpu_set_t	ps_spus;
+	pset_attrval_t	ps_non_empty_op;
+	int		ps_min_spus;
+	int		ps_max_spus;
+} pset_user_set_t;
+
+typedef struct pset_user_pin {
+	pid_t			pid;     /* tid of a frozen task, or a process */
+	unsigned long long	start;   /* start time, guards against pid reuse */
+	psetid_t		pset;
+} pset_user_pin_t;
+
+typedef struct pset_user_state {
+	int		magic;
+	int		nsets;           /* sorted by id, [0] is PS_DEFAULT */
+	pset_user_set_t	set[PSET_USER_SETS];
+	int		nfrozen;         /* tasks of sets without cpus */
+	pset_user_pin_t	frozen[PSET_USER_PINS];
+	int		nstopped;        /* processes we sent SIGSTOP */
+	pset_user_pin_t	stopped[PSET_USER_PINS];
+} pset_user_state_t;
+
+typedef struct task_ref {
+	pid_t		pid;             /* process */
+	pid_t		tid;
+	psetid_t	pset;
+} task_ref_t;
+
+#define NO_STATE_FILE	(-2)     /* lock fd when nothing was created yet */
+
+/* what to do for ourselves once the state file is unlocked */
+static int self_signal = 0;
+
+/*----------------------*
+ *  tasks through /proc *
+ *----------------------*/
+
+static int
+read_stat(pid_t tid, pid_t *pgrp, int *kthread, unsigned long long *start)
+{
+	/* pick pgrp, flags and start time out of /proc/<tid>/stat */
+	char path[64], buf[1024], *s;
+	unsigned long flags;
+	FILE *f;
+	int n;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", tid);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n > 0 ? n : 0] = 0;
+
+	/* comm may hold blanks and parens, fields resume after the last ')' */
+	s = strrchr(buf, ')');
+	if (!s || (sscanf(s + 2, "%*c %*d %d %*d %*d %*d %lu "
+			  "%*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+			  pgrp, &flags, start) != 3))
+		return -1;
+	*kthread = ((flags & PF_KTHREAD) != 0);
+	return 0;
+}
+
+static unsigned long long
+task_start(pid_t tid)
+{
+	unsigned long long start;
+	pid_t pgrp;
+	int kthread;
+
+	if (read_stat(tid, &pgrp, &kthread, &start))
+		return 0;
+	return start;
+}
+
+static int
+task_uid(pid_t pid, uid_t *uid)
+{
+	/* real uid, which is what the module compares for P_UID */
+	char path[64], line[256];
+	FILE *f;
+	int retval = -1;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)){
+		if (sscanf(line, "Uid: %u", uid) == 1){
+			retval = 0;
+			break;
+		}
+	}
+	fclose(f);
+	return retval;
+}
+
+static pid_t
+gettid_self(void)
+{
+	return syscall(SYS_gettid);
+}
+
+/*--------------------*
+ *  the shared state  *
+ *--------------------*/
+
+static int
+online_cpus(cpu_set_t *cpus)
+{
+	/* parse a list like "0-3,6" */
+	FILE *f;
+	int lo, hi, c, n = 0;
+
+	CPU_ZERO(cpus);
+	f = fopen("/sys/devices/system/cpu/online", "r");
+	if (f){
+		while (fscanf(f, "%d", &lo) == 1){
+			hi = lo;
+			c = fgetc(f);
+			if (c == '-'){
+				if (fscanf(f, "%d", &hi) != 1)
+					break;
+				c = fgetc(f);
+			}
+			for (; (lo <= hi) && (lo < CPU_SETSIZE); lo++){
+				CPU_SET(lo, cpus);
+				n++;
+			}
+			if (c != ',')
+				break;
+		}
+		fclose(f);
+	}
+	if (!n && !sched_getaffinity(0, sizeof(cpu_set_t), cpus))
+		n = CPU_COUNT(cpus);
+	return n;
+}
+
+static void
+state_init(pset_user_state_t *st)
+{
+	/* the same system set pset_init builds */
+	memset(st, 0, sizeof(pset_user_state_t));
+	st->magic = PSET_USER_MAGIC;
+	st->nsets = 1;
+	st->set[0].ps_id = PS_DEFAULT;
+	st->set[0].ps_spu_count = online_cpus(&st->set[0].ps_spus);
+	st->set[0].ps_non_empty_op = PSET_ATTRVAL_FAILBUSY;
+	st->set[0].ps_min_spus = 1;
+	st->set[0].ps_max_spus = CPU_SETSIZE;
+}
+
+/* the state is ~200KB, too much for a caller's stack, so each thread
+   keeps one copy on the heap, as it has one call in flight at a time */
+static __thread pset_user_state_t *state_mem = NULL;
+static __thread pset_user_pin_t *pins_mem = NULL;
+
+static int
+state_valid(pset_user_state_t *st)
+{
+	/* a short or corrupt file must not index past the arrays */
+	return (st->magic == PSET_USER_MAGIC) &&
+	       (st->nsets >= 1) && (st->nsets <= PSET_USER_SETS) &&
+	       (st->set[0].ps_id == PS_DEFAULT) &&
+	       (st->nfrozen >= 0) && (st->nfrozen <= PSET_USER_PINS) &&
+	       (st->nstopped >= 0) && (st->nstopped <= PSET_USER_PINS);
+}
+
+static int
+state_lock(pset_user_state_t **stp, int write)
+{
+	/* load the state under flock, returns the fd to unlock with */
+	const char *path = getenv("PSET_STATE");
+	pset_user_state_t *st;
+	int fd;
+
+	if (!state_mem)
+		state_mem = malloc(sizeof(pset_user_state_t));
+	if (!pins_mem)
+		pins_mem = malloc(PSET_USER_PINS * sizeof(pset_user_pin_t));
+	if (!state_mem || !pins_mem){
+		errno = ENOMEM;
+		return -1;
+	}
+	st = *stp = state_mem;
+
+	if (!path)
+		path = PSET_USER_STATE;
+
+	fd = open(path, write ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0){
+		if (!write && (errno == ENOENT)){
+			state_init(st);
+			return NO_STATE_FILE;
+		}
+		if ((errno == EACCES) || (errno == EROFS))
+			errno = EPERM;
+		return -1;
+	}
+	if (flock(fd, write ? LOCK_EX : LOCK_SH)){
+		close(fd);
+		return -1;
+	}
+	if ((pread(fd, st, sizeof(pset_user_state_t), 0) != sizeof(pset_user_state_t)) ||
+	    !state_valid(st))
+		state_init(st);
+	return fd;
+}
+
+static int
+state_unlock(int fd, pset_user_state_t *st)
+{
+	/* write back when st is given, then drop the lock */
+	int retval = 0;
+
+	if (fd < 0)
+		return 0;
+	if (st && (pwrite(fd, st, sizeof(pset_user_state_t), 0) != sizeof(pset_user_state_t)))
+		retval = -1;
+	close(fd);
+
+	/* freezing or killing ourselves had to wait until now */
+	if (self_signal){
+		kill(getpid(), self_signal);
+		self_signal = 0;
+	}
+	return retval;
+}
+
+static pset_user_set_t *
+find_pset(pset_user_state_t *st, psetid_t ps_id)
+{
+	int i;
+
+	for (i = 0; i < st->nsets; i++){
+		if (st->set[i].ps_id == ps_id)
+			return &st->set[i];
+	}
+	return NULL;
+}
+
+static pset_user_set_t *
+pset_of_spu(pset_user_state_t *st, int spu)
+{
+	int i;
+
+	if ((spu < 0) || (spu >= CPU_SETSIZE))
+		return NULL;
+	for (i = 0; i < st->nsets; i++){
+		if (CPU_ISSET(spu, &st->set[i].ps_spus))
+			return &st->set[i];
+	}
+	return NULL;
+}
+
+static pset_user_pin_t *
+find_pin(pset_user_pin_t *pins, int count, pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < count; i++){
+		if (pins[i].pid == pid)
+			return &pins[i];
+	}
+	return NULL;
+}
+
+/*-------------------------------*
+ *  membership, our alt_policy   *
+ *-------------------------------*/
+
+static psetid_t
+pset_of_task(pset_user_state_t *st, pid_t tid)
+{
+	pset_user_pin_t *pin;
+	cpu_set_t mask;
+	int i;
+
+	pin = find_pin(st->frozen, st->nfrozen, tid);
+	if (pin && (pin->start == task_start(tid)))
+		return pin->pset;
+
+	if (!sched_getaffinity(tid, sizeof(cpu_set_t), &mask)){
+		for (i = 1; i < st->nsets; i++){
+			if (st->set[i].ps_spu_count &&
+			    CPU_EQUAL(&mask, &st->set[i].ps_spus))
+				return st->set[i].ps_id;
+		}
+	}
+	return PS_DEFAULT;
+}
+
+static int
+tasks_scan(pset_user_state_t *st, task_ref_t **out)
+{
+	/* every thread on the system with its set, grouped by process */
+	DIR *procs, *threads;
+	struct dirent *pd, *td;
+	task_ref_t *t = NULL, *bigger;
+	int n = 0, room = 0;
+	char path[64];
+	pid_t pid, tid;
+
+	procs = opendir("/proc");
+	if (!procs)
+		return -1;
+	while ((pd = readdir(procs))){
+		pid = atoi(pd->d_name);
+		if (pid <= 0)
+			continue;
+		snprintf(path, sizeof(path), "/proc/%d/task", pid);
+		threads = opendir(path);
+		if (!threads)
+			continue;	/* exited since readdir */
+		while ((td = readdir(threads))){
+			tid = atoi(td->d_name);
+			if (tid <= 0)
+				continue;
+			if (n == room){
+				room = room ? room * 2 : 1024;
+				bigger = realloc(t, room * sizeof(task_ref_t));
+				if (!bigger){
+					closedir(threads);
+					closedir(procs);
+					free(t);
+					errno = ENOMEM;
+					return -1;
+				}
+				t = bigger;
+			}
+			t[n].pid = pid;
+			t[n].tid = tid;
+			t[n].pset = pset_of_task(st, tid);
+			n++;
+		}
+		closedir(threads);
+	}
+	closedir(procs);
+
+	*out = t;
+	return n;
+}
+
+static int
+tasks_apply(pset_user_state_t *st, task_ref_t *t, int n, psetid_t a, psetid_t b)
+{
+	/*
+	 * push the sets in t[].pset back out, as pset_assign resets the
+	 * cpus_allowed of every task in the new and old pset.  masks are
+	 * only written for tasks now in set a or b, or everywhere when a is
+	 * PS_QUERY.  frozen and stopped lists are rebuilt from scratch, which
+	 * also forgets tasks that have exited.  returns the first error
+	 * hit writing a mask, for callers that moved a single task.
+	 */
+	pset_user_pin_t *stopped = pins_mem;    /* from state_lock */
+	pset_user_set_t *ps;
+	pset_user_pin_t *pin;
+	int i, j, nstopped = 0, frozen, retval = 0;
+	pid_t self = getpid();
+
+	st->nfrozen = 0;
+	for (i = 0; i < n; i = j){
+		frozen = 0;
+		for (j = i; (j < n) && (t[j].pid == t[i].pid); j++){
+			ps = find_pset(st, t[j].pset);
+			if (!ps){
+				/* its set went away, as on destroy */
+				t[j].pset = PS_DEFAULT;
+				ps = &st->set[0];
+			}
+			if (!ps->ps_spu_count){
+				frozen = 1;
+				if (st->nfrozen < PSET_USER_PINS){
+					pin = &st->frozen[st->nfrozen++];
+					pin->pid = t[j].tid;
+					pin->start = task_start(t[j].tid);
+					pin->pset = t[j].pset;
+				}
+			} else if ((a == PS_QUERY) || (t[j].pset == a) || (t[j].pset == b)){
+				if (sched_setaffinity(t[j].tid, sizeof(cpu_set_t), &ps->ps_spus) &&
+				    !retval)
+					retval = errno;
+			}
+		}
+
+		pin = find_pin(st->stopped, st->nstopped, t[i].pid);
+		if (pin && (pin->start != task_start(t[i].pid)))
+			pin = NULL;
+		if (frozen && (nstopped < PSET_USER_PINS)){
+			stopped[nstopped].pid = t[i].pid;
+			stopped[nstopped].start = task_start(t[i].pid);
+			stopped[nstopped].pset = PS_NONE;
+			nstopped++;
+			if (!pin){
+				if (t[i].pid == self)
+					self_signal = SIGSTOP;
+				else kill(t[i].pid, SIGSTOP);
+			}
+		} else if (!frozen && pin)
+			kill(t[i].pid, SIGCONT);
+	}
+
+	memcpy(st->stopped, stopped, nstopped * sizeof(pset_user_pin_t));
+	st->nstopped = nstopped;
+	return retval;
+}
+
+/*-----------------------------------*
+ *  implementation of pset calls     *
+ *-----------------------------------*/
+
+int
+pset_create(psetid_t *pset)
+{
+	/* create a new pset and return the id, filling the first id gap */
+	pset_user_state_t *st;
+	pset_user_set_t *new;
+	int fd, i;
+
+	if (!pset){
+		errno = EFAULT;
+		return -1;
+	}
+
+	fd = state_lock(&st, 1);
+	if (fd < 0)
+		return -1;
+
+	if ((st->nsets >= PSET_USER_SETS) || (st->nsets + 1 > PS_MAXPSET)){
+		state_unlock(fd, NULL);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (i = 1; i < st->nsets; i++){
+		if (st->set[i].ps_id - st->set[i - 1].ps_id > 1)
+			break;
+	}
+	memmove(&st->set[i + 1], &st->set[i], (st->nsets - i) * sizeof(pset_user_set_t));
+	st->nsets++;
+
+	new = &st->set[i];
+	memset(new, 0, sizeof(pset_user_set_t));
+	new->ps_id = st->set[i - 1].ps_id + 1;
+	new->ps_non_empty_op = PSET_ATTRVAL_DFLTPSET;
+	new->ps_min_spus = 0;
+	new->ps_max_spus = CPU_SETSIZE;
+	CPU_ZERO(&new->ps_spus);
+
+	*pset = new->ps_id;
+	return state_unlock(fd, st);
+}
+
+int
+pset_destroy(psetid_t pset)
+{
+	/*
+	 * destroy an existing pset.  its cpus go back to the default set.
+	 * tasks still in it make it fail (FAILBUSY), move to the default
+	 * set (DFLTPSET) or move there and get SIGKILL (KILL).
+	 */
+	pset_user_state_t *st;
+	pset_user_set_t *ps;
+	task_ref_t *t;
+	int fd, n, i, retval = 0;
+	pset_attrval_t op;
+	pid_t self = getpid(), killed = 0;
+	pid_t pgrp;
+	int kthread;
+	unsigned long long start;
+
+	/* prevents destroy of 0 */
+	if ((pset <= PS_DEFAULT) || (pset >= PS_MAXPSET)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = state_lock(&st, 1);
+	if (fd < 0)
+		return -1;
+
+	ps = find_pset(st, pset);
+	if (!ps){
+		state_unlock(fd, NULL);
+		errno = ESRCH;
+		return -1;
+	}
+	op = ps->ps_non_empty_op;
+
+	n = tasks_scan(st, &t);
+	if (n < 0){
+		state_unlock(fd, NULL);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++){
+		if (t[i].pset != pset)
+			continue;
+		if (op == PSET_ATTRVAL_FAILBUSY){
+			retval = EBUSY;
+			break;
+		}
+		t[i].pset = PS_DEFAULT;
+
+		/* once per process, never init or a kernel thread */
+		if ((op == PSET_ATTRVAL_KILL) && (t[i].pid > 1) && (t[i].pid != killed) &&
+		    !read_stat(t[i].pid, &pgrp, &kthread, &start) && !kthread){
+			killed = t[i].pid;
+			if (t[i].pid == self)
+				self_signal = SIGKILL;
+			else kill(t[i].pid, SIGKILL);
+		}
+	}
+
+	if (retval){
+		/* don't remove if a task is still in there */
+		free(t);
+		state_unlock(fd, NULL);
+		errno = retval;
+		return -1;
+	}
+
+	/* hand the cpus back, then drop the set from the sorted list */
+	CPU_OR(&st->set[0].ps_spus, &st->set[0].ps_spus, &ps->ps_spus);
+	st->set[0].ps_spu_count += ps->ps_spu_count;
+	i = ps - st->set;
+	memmove(&st->set[i], &st->set[i + 1], (st->nsets - i - 1) * sizeof(pset_user_set_t));
+	st->nsets--;
+
+	tasks_apply(st, t, n, PS_DEFAULT, PS_DEFAULT);
+	free(t);
+	return state_unlock(fd, st);
+}
+
+int
+pset_assign(psetid_t pset, int spu, psetid_t *opset)
+{
+	/* put a CPU into a pset, and return the old membership/error */
+	pset_user_state_t *st;
+	pset_user_set_t *ps, *old;
+	task_ref_t *t;
+	psetid_t new_id, old_id;
+	int fd, n;
+
+	if ((pset < PS_QUERY) || (pset > PS_MAXPSET) || !opset){
+		errno = opset ? EINVAL : EFAULT;
+		return -1;
+	}
+
+	fd = state_lock(&st, pset != PS_QUERY);
+	if (fd == -1)
+		return -1;
+
+	old = pset_of_spu(st, spu);
+	if (!old){
+		state_unlock(fd, NULL);
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* special case, just asking what current assignment is */
+	if (pset == PS_QUERY){
+		*opset = old->ps_id;
+		state_unlock(fd, NULL);
+		return 0;
+	}
+
+	/* this prevents last cpu from ever leaving the default group */
+	if ((old->ps_id == PS_DEFAULT) && (old->ps_spu_count <= 1)){
+		state_unlock(fd, NULL);
+		errno = EBUSY;
+		return -1;
+	}
+
+	ps = find_pset(st, pset);
+	if (!ps){
+		state_unlock(fd, NULL);
+		errno = ESRCH;
+		return -1;
+	}
+	*opset = old->ps_id;
+	if (ps == old)
+		return state_unlock(fd, NULL);
+
+	/* membership comes from the masks, so read it before they change */
+	n = tasks_scan(st, &t);
+	if (n < 0){
+		state_unlock(fd, NULL);
+		return -1;
+	}
+
+	CPU_CLR(spu, &old->ps_spus);
+	old->ps_spu_count--;
+	CPU_SET(spu, &ps->ps_spus);
+	ps->ps_spu_count++;
+	new_id = ps->ps_id;
+	old_id = old->ps_id;
+
+	tasks_apply(st, t, n, new_id, old_id);
+	free(t);
+	return state_unlock(fd, st);
+}
+
+int
+pset_bind(psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset)
+{
+	/* put tasks into a pset, and return the old membership/error */
+	pset_user_state_t *st;
+	task_ref_t *t;
+	int fd, n, i, retval = ESRCH, err;
+	pid_t pgrp;
+	int kthread;
+	unsigned long long start;
+	uid_t uid;
+
+	if (!opset){
+		errno = EFAULT;
+		return -1;
+	}
+
+	if (pset == PS_QUERY){
+		fd = state_lock(&st, 0);
+		if (fd == -1)
+			return -1;
+		if (id == PS_MYID)
+			id = gettid_self();
+		if (task_start(id) || (id == gettid_self())){
+			*opset = pset_of_task(st, id);
+			retval = 0;
+		}
+		state_unlock(fd, NULL);
+		if (retval){
+			errno = retval;
+			return -1;
+		}
+		return 0;
+	}
+
+	if ((pset < PS_DEFAULT) || (pset > PS_MAXPSET) || (id < PS_MYID)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	switch (idtype){
+	case P_PGID:
+		if (id == PS_MYID)
+			id = getpgrp();
+		if ((id == 0) || (id == 1)){
+			errno = EPERM;
+			return -1;
+		}
+		break;
+	case P_PID:
+		if (id == PS_MYID)
+			id = gettid_self();
+		break;
+	case P_TGID:
+		if (id == PS_MYID)
+			id = getpid();
+		break;
+	case P_UID:
+		if (id == PS_MYID)
+			id = getuid();
+		/* like pgrp 0 and 1, moving every root task is refused */
+		if (id == 0){
+			errno = EPERM;
+			return -1;
+		}
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = state_lock(&st, 1);
+	if (fd < 0)
+		return -1;
+	if (!find_pset(st, pset)){
+		state_unlock(fd, NULL);
+		errno = ESRCH;
+		return -1;
+	}
+
+	n = tasks_scan(st, &t);
+	if (n < 0){
+		state_unlock(fd, NULL);
+		return -1;
+	}
+
+	/* note: we ignore opset for all but PID and TGID types */
+	for (i = 0; i < n; i++){
+		switch (idtype){
+		case P_PGID:
+			if (read_stat(t[i].tid, &pgrp, &kthread, &start) || (pgrp != id))
+				continue;
+			break;
+		case P_UID:
+			if (task_uid(t[i].pid, &uid) || (uid != (uid_t)id))
+				continue;
+			break;
+		case P_TGID:
+			if (t[i].pid != id)
+				continue;
+			if (t[i].tid == id)
+				*opset = t[i].pset;
+			break;
+		default:
+		case P_PID:
+			if (t[i].tid != id)
+				continue;
+			*opset = t[i].pset;
+			break;
+		}
+		t[i].pset = pset;
+		retval = 0;
+	}
+
+	if (retval){
+		free(t);
+		state_unlock(fd, NULL);
+		errno = retval;
+		return -1;
+	}
+
+	/* a single task that refuses the mask is an error, in a group it's not */
+	err = tasks_apply(st, t, n, pset, pset);
+	free(t);
+	if (state_unlock(fd, st))
+		return -1;
+	if (err && (idtype == P_PID)){
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int
+pset_getattr(psetid_t pset, pset_attrtype_t type, pset_attrval_t *value)
+{
+	/* look up the specified attribute of the indicated pset */
+	pset_user_state_t *st;
+	pset_user_set_t *ps;
+	int fd;
+
+	if ((pset < PS_DEFAULT) || (pset >= PS_MAXPSET)){
+		errno = EINVAL;
+		return -1;
+	}
+	if (!value){
+		errno = EFAULT;
+		return -1;
+	}
+	if ((type != PSET_ATTR_NONEMPTY) && (type != PSET_ATTR_MINSPUS) &&
+	    (type != PSET_ATTR_MAXSPUS)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = state_lock(&st, 0);
+	if (fd == -1)
+		return -1;
+	ps = find_pset(st, pset);
+	if (ps){
+		if (type == PSET_ATTR_MINSPUS)
+			*value = ps->ps_min_spus;
+		else if (type == PSET_ATTR_MAXSPUS)
+			*value = ps->ps_max_spus;
+		else *value = ps->ps_non_empty_op;
+	}
+	state_unlock(fd, NULL);
+
+	if (!ps){
+		errno = ESRCH;
+		return -1;
+	}
+	return 0;
+}
+
+int
+pset_setattr(psetid_t pset, pset_attrtype_t type, pset_attrval_t value)
+{
+	/* set the specified attribute of the indicated pset */
+	pset_user_state_t *st;
+	pset_user_set_t *ps;
+	int fd, retval = 0;
+
+	if ((pset < PS_DEFAULT) || (pset > PS_MAXPSET)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	switch (type){
+	case PSET_ATTR_NONEMPTY:
+		/* prevents change of 0 */
+		if ((pset == PS_DEFAULT) ||
+		    (value < PSET_ATTRVAL_FAILBUSY) || (value > PSET_ATTRVAL_KILL)){
+			errno = EINVAL;
+			return -1;
+		}
+		break;
+	case PSET_ATTR_MINSPUS:
+	case PSET_ATTR_MAXSPUS:
+		/* value is a cpu count for these */
+		if (((int)value < 0) || ((int)value > CPU_SETSIZE)){
+			errno = EINVAL;
+			return -1;
+		}
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = state_lock(&st, 1);
+	if (fd < 0)
+		return -1;
+	ps = find_pset(st, pset);
+	if (!ps)
+		retval = ESRCH;
+	else if (type == PSET_ATTR_MINSPUS){
+		/* the default set always keeps its last cpu */
+		if (((int)value > ps->ps_max_spus) ||
+		    ((pset == PS_DEFAULT) && ((int)value < 1)))
+			retval = EINVAL;
+		else ps->ps_min_spus = value;
+	} else if (type == PSET_ATTR_MAXSPUS){
+		if ((int)value < ps->ps_min_spus)
+			retval = EINVAL;
+		else ps->ps_max_spus = value;
+	} else ps->ps_non_empty_op = value;
+
+	if (retval){
+		state_unlock(fd, NULL);
+		errno = retval;
+		return -1;
+	}
+	return state_unlock(fd, st);
+}
+
+int
+pset_ctl(pset_request_t req, psetid_t pset, id_t id)
+{
+	/* look up a wide range of information about pset, CPU, or own task */
+	pset_user_state_t *st;
+	pset_user_set_t *ps;
+	int fd, i, retval = -EINVAL;
+
+	fd = state_lock(&st, 0);
+	if (fd == -1)
+		return -1;
+
+	switch (req){
+	case PSET_GETNUMPSETS:
+		retval = st->nsets;
+		break;
+
+	case PSET_GETFIRSTPSET:
+		retval = PS_DEFAULT;
+		break;
+
+	case PSET_GETNEXTPSET:
+		retval = -ESRCH;
+		for (i = 0; i < st->nsets; i++){
+			if (st->set[i].ps_id > pset){
+				retval = st->set[i].ps_id;
+				break;
+			}
+		}
+		break;
+
+	case PSET_GETCURRENTPSET:
+		retval = pset_of_task(st, gettid_self());
+		break;
+
+	case PSET_GETNUMSPUS:
+		ps = find_pset(st, pset);
+		retval = ps ? ps->ps_spu_count : -ESRCH;
+		break;
+
+	case PSET_GETFIRSTSPU:
+		id = -1;
+		/* fall through */
+	case PSET_GETNEXTSPU:
+		ps = find_pset(st, pset);
+		if (!ps){
+			retval = -ESRCH;
+			break;
+		}
+		if (!ps->ps_spu_count){
+			retval = -ENOENT;
+			break;
+		}
+		retval = -EAGAIN;
+		for (i = (id < -1) ? 0 : id + 1; i < CPU_SETSIZE; i++){
+			if (CPU_ISSET(i, &ps->ps_spus)){
+				retval = i;
+				break;
+			}
+		}
+		break;
+
+	case PSET_SPUTOPSET:
+		ps = pset_of_spu(st, id);
+		retval = ps ? ps->ps_id : -EINVAL;
+		break;
+
+	default:
+		/* defaults to EINVAL */
+		break;
+	}
+	state_unlock(fd, NULL);
+
+	if (retval < 0){
+		errno = -retval;
+		return -1;
+	}
+	return retval;
+}
+
+#ifdef PSET_USER_MAIN
+/*
+ * usage: pset_user create
+ *        pset_user destroy <pset>
+ *        pset_user assign <pset|-1> <cpu>
+ *        pset_user bind <pset|-1> pid|tgid|pgid|uid <id|-1>
+ *        pset_user getattr <pset> nonempty|minspus|maxspus
+ *        pset_user setattr <pset> nonempty failbusy|dfltpset|kill
+ *        pset_user setattr <pset> minspus|maxspus <count>
+ *        pset_user show
+ */
+
+static int
+usage(void)
+{
+	fprintf(stderr, "usage: pset_user create | destroy pset | assign pset cpu |\n"
+		"       bind pset pid|tgid|pgid|uid id | getattr pset attr |\n"
+		"       setattr pset attr value | show\n");
+	return 2;
+}
+
+static int
+attr_of(const char *s)
+{
+	if (!strcmp(s, "nonempty"))
+		return PSET_ATTR_NONEMPTY;
+	if (!strcmp(s, "minspus"))
+		return PSET_ATTR_MINSPUS;
+	if (!strcmp(s, "maxspus"))
+		return PSET_ATTR_MAXSPUS;
+	return -1;
+}
+
+static void
+show(void)
+{
+	psetid_t ps;
+	pset_attrval_t op;
+	int spu;
+
+	for (ps = pset_ctl(PSET_GETFIRSTPSET, 0, 0); ps >= 0;
+	     ps = pset_ctl(PSET_GETNEXTPSET, ps, 0)){
+		pset_getattr(ps, PSET_ATTR_NONEMPTY, &op);
+		printf("pset %d: %d cpus, nonempty %d, cpus", ps,
+		       pset_ctl(PSET_GETNUMSPUS, ps, 0), op);
+		for (spu = pset_ctl(PSET_GETFIRSTSPU, ps, 0); spu >= 0;
+		     spu = pset_ctl(PSET_GETNEXTSPU, ps, spu))
+			printf(" %d", spu);
+		printf("\n");
+	}
+	printf("this task is in pset %d\n", pset_ctl(PSET_GETCURRENTPSET, 0, 0));
+}
+
+int
+main(int argc, char **argv)
+{
+	psetid_t ps, old;
+	pset_attrval_t value;
+	idtype_t idtype;
+	int rc = -1, attr;
+
+	if (argc < 2)
+		return usage();
+
+	if (!strcmp(argv[1], "create")){
+		rc = pset_create(&ps);
+		if (!rc)
+			printf("%d\n", ps);
+	} else if (!strcmp(argv[1], "destroy") && (argc == 3)){
+		rc = pset_destroy(atoi(argv[2]));
+	} else if (!strcmp(argv[1], "assign") && (argc == 4)){
+		rc = pset_assign(atoi(argv[2]), atoi(argv[3]), &old);
+		if (!rc)
+			printf("cpu %s was in pset %d\n", argv[3], old);
+	} else if (!strcmp(argv[1], "bind") && (argc == 5)){
+		if (!strcmp(argv[3], "pid"))
+			idtype = P_PID;
+		else if (!strcmp(argv[3], "tgid"))
+			idtype = P_TGID;
+		else if (!strcmp(argv[3], "pgid"))
+			idtype = P_PGID;
+		else if (!strcmp(argv[3], "uid"))
+			idtype = P_UID;
+		else return usage();
+		old = PS_NONE;
+		rc = pset_bind(atoi(argv[2]), idtype, atoi(argv[4]), &old);
+		if (!rc)
+			printf("%s %s was in pset %d\n", argv[3], argv[4], old);
+	} else if (!strcmp(argv[1], "getattr") && (argc == 4)){
+		attr = attr_of(argv[3]);
+		if (attr < 0)
+			return usage();
+		rc = pset_getattr(atoi(argv[2]), attr, &value);
+		if (!rc)
+			printf("%d\n", value);
+	} else if (!strcmp(argv[1], "setattr") && (argc == 5)){
+		attr = attr_of(argv[3]);
+		if (attr < 0)
+			return usage();
+		if (!strcmp(argv[4], "failbusy"))
+			value = PSET_ATTRVAL_FAILBUSY;
+		else if (!strcmp(argv[4], "dfltpset"))
+			value = PSET_ATTRVAL_DFLTPSET;
+		else if (!strcmp(argv[4], "kill"))
+			value = PSET_ATTRVAL_KILL;
+		else value = atoi(argv[4]);
+		rc = pset_setattr(atoi(argv[2]), attr, value);
+	} else if (!strcmp(argv[1], "show")){
+		show();
+		rc = 0;
+	} else return usage();
+
+	if (rc < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	return 0;
+}
+#endif
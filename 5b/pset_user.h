@@ -0,0 +1,25 @@
+#ifndef _SCHED_PSET_USER_H
+#define _SCHED_PSET_USER_H
+
+/*
+ * processor sets in user space, for kernels that cannot load pset.o.
+ * same calls, requests and attributes as the pset library over pset.h,
+ * built on sched_setaffinity.  errors are -1 with errno set.
+ */
+
+#include <sys/types.h>
+
+#define id_t pset_id_t          /* pset.h has its own, signed, id_t */
+#include "pset.h"
+
+#define PSET_USER_STATE "/dev/shm/pset_user"   /* PSET_STATE overrides */
+
+int pset_create(psetid_t *newpset);
+int pset_destroy(psetid_t pset);
+int pset_assign(psetid_t pset, int spu, psetid_t *opset);
+int pset_bind(psetid_t pset, idtype_t idtype, id_t id, psetid_t *opset);
+int pset_getattr(psetid_t pset, pset_attrtype_t type, pset_attrval_t *value);
+int pset_setattr(psetid_t pset, pset_attrtype_t type, pset_attrval_t value);
+int pset_ctl(pset_request_t req, psetid_t pset, id_t id);
+
+#endif
@@ -5,268 +5,2455 @@
 * scheduling.c
 *******************************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "utils.c"
 
-#define NUM_PROCESSES 20
+#define NUM_PROCESSES 20  /* Default, can be given on the command line */
+#define QUANTUM 10        /* Default slice of ctrr, stride and lottery */
+#define TICKETS 100       /* Share of priority 0, doubled per priority level */
+#define STRIDE1 (1 << 20) /* Stride of a process holding a single ticket */
+#define TARGET_LATENCY 20 /* Fair policy: time to run every job once */
+#define MIN_GRANULARITY 4 /* Fair policy: shortest slice handed out */
+#define CACHE_JOBS 4      /* Other jobs run before one finds its cache cold */
+#define CACHE_MB 256      /* Default size bound of the result cache */
+#define SEED 0xC0FFEE     /* Draws the workload printed in the tests */
+#define MAX_QUANTA 16     /* Quanta in a sweep */
+#define CPUS 8            /* CPUs of the multi-threaded policies */
+#define MAX_THREADS 8     /* Most threads a random job draws */
 
+int num_processes = NUM_PROCESSES;
+int quantum = QUANTUM;
+int quanta[MAX_QUANTA] = {QUANTUM};   /* Swept, the first runs otherwise */
+int quantum_count = 1;
+int cpus = CPUS;
+int quiet = 0;            /* Skip per process output, print timings */
+int target_latency = TARGET_LATENCY;
+int min_granularity = MIN_GRANULARITY;
+
+/* Dispatch cost model, free unless set on the command line */
+int switch_cost = 0;      /* Time to switch to another job */
+int warmup_cost = 0;      /* More on a resume once the job's cache is cold */
+int cache_jobs = CACHE_JOBS;
+long switch_lost;         /* Time the current policy spent on both */
+int dispatches;           /* Dispatches so far in the current policy */
+int last_dispatched;      /* Job the CPU was last given to */
+
+/* Result cache, off unless given a directory */
+char *cache_dir = NULL;
+long long cache_limit = (long long)CACHE_MB << 20;
+hash128 workload_hash;    /* Of every process's workload fields */
+
+/* Offline bounds on the workload, off unless asked for */
+int show_bounds = 0;
+wide best_sum;            /* Turnarounds under SRPT, the least possible */
+long long best_makespan;  /* Finish of any work-conserving schedule */
+int bounded;              /* The running policy is on one CPU, so held to them */
+
+/*
+ * Times are 64 bit, so a trace can run for days in microseconds.  The
+ * times come first and the small fields pack in behind them, the whole
+ * record filling one 64 byte cache line.
+ */
 struct process
 {
   /* Values initialized for each process */
-  int arrivaltime;  /* Time process arrives and wishes to start */
-  int runtime;      /* Time process requires to complete job */
-  int priority;     /* Priority of the process */
+  long long arrivaltime;    /* Time process arrives and wishes to start */
+  long long runtime;        /* Time process requires to complete job */
+  long long deadline;       /* Time the job should be done by, 0 if it has none */
 
   /* Values algorithm may use to track processes */
-  int starttime;
-  int endtime;
-  int flag;
-  int remainingtime;
+  long long starttime;
+  long long endtime;
+  long long remainingtime;
+  int lastrun;              /* Dispatch count at its last run, for the cost model */
+  int runs;                 /* Times given the CPU by a switch, preemptions + 1 */
+
+  int tickets;              /* Proportional share, follows priority */
+  unsigned priority : 8;    /* Priority of the process */
+  unsigned flag : 1;
+  unsigned threads : 16;    /* Threads of the job, each needing runtime */
 };
 
+/*
+ * What-if questions, -e id=runtime[,id=runtime...], each answered against
+ * the run just made.  The answer is how many dispatches had to be run
+ * again, the average turnaround, and unless quiet every job whose
+ * schedule moved.
+ */
+#define MAX_QUESTIONS 16
+#define MAX_EDITS 16
+
+typedef struct question{
+  char *text;
+  int edits;
+  int id[MAX_EDITS];
+  long long runtime[MAX_EDITS];
+}question;
+
+question questions[MAX_QUESTIONS];
+int question_count = 0;
+int keep_trace = 0;       /* Runs keep what the questions need */
+
 /* Forward declarations of Scheduling algorithms */
 void first_come_first_served(struct process *proc);
 void shortest_remaining_time(struct process *proc);
 void round_robin(struct process *proc);
 void round_robin_priority(struct process *proc);
+void const_round_robin(struct process *proc);
+void stride_scheduling(struct process *proc);
+void lottery_scheduling(struct process *proc);
+void fair_scheduling(struct process *proc);
+void earliest_deadline_first(struct process *proc);
+void earliest_deadline_admission(struct process *proc);
+void gang_scheduling(struct process *proc);
+void thread_scheduling(struct process *proc);
+void generate(struct process *proc, unsigned seed);
+void fairness(struct process *proc);
+void bounds(struct process *proc);
+void share_by_priority(struct process *proc);
+void deadlines(struct process *proc);
+int read_workload(char *path, struct process **proc);
+int write_workload(char *path, struct process *proc);
+int write_results(char *prefix, char *name, struct process *proc);
+int dump_file(char *path);
+void hash_workload(struct process *proc);
+void cache_key(char *name, char *key);
+int cache_load(char *key, struct process *proc);
+FILE *cache_begin(char *key, capture *c);
+void cache_store(char *key, capture *c, FILE *out, struct process *proc);
+int parse_question(char *text, question *q);
+void np_whatif(struct process *proc, question *q);
+void drop_trace();
+
+struct policy
+{
+  char *name;                          /* Picked on the command line */
+  char *title;                         /* Printed before the run */
+  void (*run)(struct process *proc);
+  void (*whatif)(struct process *proc, question *q);  /* NULL reruns */
+  int sliced;                          /* Reads quantum, so sweeps try each */
+  int parallel;                        /* Runs threads on -P CPUs, past bounds */
+};
 
-int main()
+struct policy policies[] =
 {
+  {"fcfs", "First come first served", first_come_first_served, np_whatif},
+  {"srt", "Shortest remaining time", shortest_remaining_time, np_whatif},
+  {"rr", "Round Robin", round_robin, NULL, 1},
+  {"rrp", "Round Robin with priority", round_robin_priority, NULL, 1},
+  {"ctrr", "Constant time round robin", const_round_robin, NULL, 1},
+  {"stride", "Stride scheduling", stride_scheduling, NULL, 1},
+  {"lottery", "Lottery scheduling", lottery_scheduling, NULL, 1},
+  {"cfs", "Completely fair scheduling", fair_scheduling},
+  {"edf", "Earliest deadline first", earliest_deadline_first},
+  {"edfac", "Earliest deadline first with admission control",
+   earliest_deadline_admission},
+  {"gang", "Gang scheduling", gang_scheduling, NULL, 1, 1},
+  {"threads", "Independent thread scheduling", thread_scheduling, NULL, 1, 1},
+  {NULL, NULL, NULL}
+};
+
+void whatif_rerun(struct policy *p, struct process *base, struct process *proc,
+                  question *q);
+int parse_quanta(char *text);
+int run_sweep(int seeds, int workers, char *name);
+
+int main(int argc, char *argv[])
+{
+  int i, k, dirty;
+  int seeds = 0;            /* Sweep this many workloads instead */
+  int workers = worker_count(1, 0);  /* Processes to sweep in */
+  char *policy = NULL;      /* Run only this policy, all if NULL */
+  char *load = NULL;        /* Workload file to run instead of a random one */
+  char *save = NULL;        /* Workload file to write */
+  char *results = NULL;     /* Prefix of the result file of each policy */
+  clock_t start;
+  char key[33];
+  capture cap;
+  FILE *out;
+  struct process *proc,      /* List of processes */
+                 *proc_copy; /* Backup copy of processes */
+
+  /*
+   * Usage: sch [-q] [-b] [-l latency] [-g granularity]
+   *            [-c switch cost] [-w warmup cost] [-n cache jobs]
+   *            [-i workload] [-o workload] [-r result prefix]
+   *            [-C cache dir] [-M cache MB]
+   *            [-e id=runtime[,id=runtime...]]...
+   *            [-Q quantum[,quantum...]] [-S seeds] [-j workers] [-P cpus]
+   *            [processes] [policy]
+   *        sch -d file      prints a workload or result file as text
+   */
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-q") == 0){
+      quiet = 1;
+    }
+    else if(strcmp(argv[i], "-b") == 0){
+      show_bounds = 1;
+    }
+    else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc){
+      target_latency = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc){
+      min_granularity = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+      switch_cost = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc){
+      warmup_cost = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+      cache_jobs = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc){
+      load = argv[++i];
+    }
+    else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+      save = argv[++i];
+    }
+    else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+      results = argv[++i];
+    }
+    else if(strcmp(argv[i], "-C") == 0 && i + 1 < argc){
+      cache_dir = argv[++i];
+    }
+    else if(strcmp(argv[i], "-M") == 0 && i + 1 < argc){
+      cache_limit = atoll(argv[++i]) << 20;
+    }
+    else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){
+      if(question_count == MAX_QUESTIONS ||
+         !parse_question(argv[++i], &questions[question_count++])){
+        printf("What-if questions are up to %d of id=runtime[,id=runtime...]\n",
+               MAX_QUESTIONS);
+        return 1;
+      }
+    }
+    else if(strcmp(argv[i], "-Q") == 0 && i + 1 < argc){
+      if(!parse_quanta(argv[++i])){
+        printf("Quanta are up to %d positive numbers, comma separated\n",
+               MAX_QUANTA);
+        return 1;
+      }
+    }
+    else if(strcmp(argv[i], "-S") == 0 && i + 1 < argc){
+      seeds = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+      workers = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-P") == 0 && i + 1 < argc){
+      cpus = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc){
+      return dump_file(argv[++i]);
+    }
+    else if(atoi(argv[i]) > 0){
+      num_processes = atoi(argv[i]);
+    }
+    else{
+      policy = argv[i];
+    }
+  }
+
+  if(target_latency < 1 || min_granularity < 1){
+    printf("Latency and granularity must be at least 1\n");
+    return 1;
+  }
+  if(switch_cost < 0 || warmup_cost < 0 || cache_jobs < 0){
+    printf("Switch costs and cache jobs can't be negative\n");
+    return 1;
+  }
+  if(cpus < 1){
+    printf("There must be at least 1 CPU\n");
+    return 1;
+  }
+
+  if(seeds > 0){
+    if(load != NULL || question_count > 0 || workers < 1){
+      printf("Sweeps draw their own workloads, without questions, on 1 or more workers\n");
+      return 1;
+    }
+    return run_sweep(seeds, workers, policy);
+  }
+
+  if(load != NULL){
+    if(read_workload(load, &proc) != 0){
+      return 1;
+    }
+  }
+  else{
+    proc = (struct process*)malloc(num_processes * sizeof(struct process));
+  }
+  proc_copy = (struct process*)malloc(num_processes * sizeof(struct process));
+  if(proc == NULL || proc_copy == NULL){
+    printf("Not enough memory for %d processes\n", num_processes);
+    return 1;
+  }
+
+  if(load == NULL){
+    generate(proc, SEED);
+  }
+
+  if(save != NULL && write_workload(save, proc) != 0){
+    printf("Can't write workload %s\n", save);
+    return 1;
+  }
+
+  /* Show process values */
+  if(!quiet){
+    printf("Process\tarrival\truntime\tpriority\n");
+    for(i=0; i<num_processes; i++)
+      printf("%d\t%lld\t%lld\t%d\n", i, proc[i].arrivaltime, proc[i].runtime,
+             proc[i].priority);
+  }
+
+  if(cache_dir != NULL){
+    hash_workload(proc);
+  }
+
+  if(show_bounds){
+    printf("\n\nOffline bounds\n");
+    start = clock();
+    bounds(proc);
+    if(quiet){
+      printf("Bounds took %.3f seconds\n",
+             (double)(clock() - start) / CLOCKS_PER_SEC);
+    }
+  }
+
+  /* Answering questions needs the run itself, not the cache */
+  keep_trace = question_count > 0;
+
+  /* Run scheduling algorithms */
+  memcpy(proc_copy, proc, num_processes * sizeof(struct process));
+  dirty = 0;
+  for(i = 0; policies[i].name != NULL; i++){
+    if(policy != NULL && strcmp(policy, policies[i].name) != 0){
+      continue;
+    }
+    printf("\n\n%s\n", policies[i].title);
+    start = clock();
+    if(cache_dir != NULL){
+      cache_key(policies[i].name, key);
+    }
+    if(cache_dir == NULL || keep_trace || !cache_load(key, proc_copy)){
+      /* A run leaves its state all over the copy, a hit only the schedule */
+      if(dirty){
+        memcpy(proc_copy, proc, num_processes * sizeof(struct process));
+      }
+      out = cache_dir != NULL ? cache_begin(key, &cap) : NULL;
+      switch_lost = 0;
+      dispatches = 0;
+      last_dispatched = -1;
+      bounded = show_bounds && !policies[i].parallel;
+      policies[i].run(proc_copy);
+      if(switch_cost > 0 || warmup_cost > 0){
+        printf("Time lost to switching is %ld seconds, %d dispatches\n",
+               switch_lost, dispatches);
+      }
+      if(out != NULL){
+        cache_store(key, &cap, out, proc_copy);
+      }
+    }
+    dirty = 1;
+    if(quiet){
+      printf("Scheduling took %.3f seconds\n",
+             (double)(clock() - start) / CLOCKS_PER_SEC);
+    }
+    fairness(proc_copy);
+    deadlines(proc_copy);
+    if(results != NULL && write_results(results, policies[i].name, proc_copy) != 0){
+      printf("Can't write results under %s\n", results);
+      return 1;
+    }
+    for(k = 0; k < question_count; k++){
+      if(policies[i].whatif != NULL){
+        policies[i].whatif(proc_copy, &questions[k]);
+      }
+      else{
+        whatif_rerun(&policies[i], proc, proc_copy, &questions[k]);
+      }
+    }
+    drop_trace();
+  }
+
+  free(proc);
+  free(proc_copy);
+  return 0;
+}
+
+/* Draws a random workload, the one printed in the tests from SEED */
+void generate(struct process *proc, unsigned seed){
   int i;
-  struct process proc[NUM_PROCESSES],      /* List of processes */
-                 proc_copy[NUM_PROCESSES]; /* Backup copy of processes */
 
   /* Seed random number generator */
   /*srand(time(0));*/  /* Use this seed to test different scenarios */
-  srand(0xC0FFEE);     /* Used for test to be printed out */
+  srand(seed);         /* SEED is used for test to be printed out */
 
   /* Initialize process structures */
-  for(i=0; i<NUM_PROCESSES; i++)
+  for(i=0; i<num_processes; i++)
   {
-    proc[i].arrivaltime = rand()%100;
+    /* Arrivals spread over 5 time units per process, 0-99 for 20 */
+    proc[i].arrivaltime = rand()%(5*num_processes);
     proc[i].runtime = (rand()%30)+10;
     proc[i].priority = rand()%3;
+    proc[i].tickets = TICKETS << proc[i].priority;
     proc[i].starttime = 0;
     proc[i].endtime = 0;
     proc[i].flag = 0;
     proc[i].remainingtime = 0;
+    proc[i].lastrun = 0;
+    proc[i].runs = 0;
+  }
+
+  /*
+   * Deadlines are drawn after the rest so the workload above stays the
+   * same.  Three jobs in four get 2-5 times their runtime to finish.
+   */
+  for(i=0; i<num_processes; i++)
+  {
+    if(rand()%4 == 0){
+      proc[i].deadline = 0;
+    }
+    else{
+      proc[i].deadline = proc[i].arrivaltime + proc[i].runtime * (rand()%4 + 2);
+    }
+  }
+
+  /* Thread counts come last for the same reason, 1, 2, 4 or 8 */
+  for(i=0; i<num_processes; i++)
+  {
+    proc[i].threads = 1 << (rand()%4);
+  }
+}
+
+/* Print process events unless running quiet on a big workload */
+void report_start(int id, long long time){
+  if(!quiet){
+    printf("Process %d started at time %lld\n", id, time);
+  }
+}
+
+void report_finish(int id, long long time){
+  if(!quiet){
+    printf("Process %d finished at time %lld\n", id, time);
+  }
+}
+
+/* Every process ordered by arrival time, ties by index, sorted once */
+stream *arrivals(struct process *proc){
+  long i;
+  stream *s = (stream*)malloc(sizeof(stream));
+  radix_item *tmp;
+
+  s->item = (radix_item*)malloc(num_processes * sizeof(radix_item));
+  tmp = (radix_item*)malloc(num_processes * sizeof(radix_item));
+  for(i = 0; i < num_processes; i++){
+    s->item[i].key = proc[i].arrivaltime;
+    s->item[i].id = i;
+  }
+  radix_sort(s->item, tmp, num_processes);
+  free(tmp);
+  s->next = 0;
+  s->size = num_processes;
+  return s;
+}
+
+/* A vector reduction down the endtime and arrivaltime columns, into 128 bits */
+void average_time(struct process *proc){
+  wide sum;
+  long long min, max, makespan = 0;
+  int i;
+  vec_span(&proc[0].endtime, &proc[0].arrivaltime, num_processes,
+           sizeof(struct process) / sizeof(long long), &sum, &min, &max);
+  printf("Average time from arrival to finish is %lld seconds\n",
+         wide_div(sum, num_processes));
+  if(quiet){
+    printf("Turnaround runs from %lld to %lld seconds\n", min, max);
+  }
+  if(bounded){
+    for(i = 0; i < num_processes; i++){
+      if(proc[i].endtime > makespan){
+        makespan = proc[i].endtime;
+      }
+    }
+    printf("That is %.3f of the optimum, makespan %lld of at least %lld\n",
+           wide_double(sum) / wide_double(best_sum),
+           makespan, best_makespan);
+  }
+}
+
+/*
+ * Bounds no policy can beat on this workload, whatever it costs to switch.
+ * Preemptive shortest remaining processing time minimises the total time
+ * from arrival to finish on one machine, and as it never idles with work
+ * waiting it finishes when every work-conserving schedule does, which no
+ * schedule beats.  A heap of remaining times preempts at most once per
+ * arrival, O(n log n) in all.  The closed form bound on the makespan,
+ * the latest arrival plus runtime or the first arrival plus all the
+ * work, shows how much of it idle time costs.
+ */
+void bounds(struct process *proc){
+  stream *a = arrivals(proc);
+  heap *h = create_heap(num_processes);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  int i, k, count, done = 0;
+  long long time = 0, left, next, work = 0, last = 0, idle = 0;
+  long long first = stream_peek(a);
+  best_sum.hi = 0;
+  best_sum.lo = 0;
+  while(done < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      heap_push(h, batch[k], proc[batch[k]].runtime);
+    }
+    if(h->size == 0){
+      next = stream_peek(a);
+      idle += next - time;
+      time = next;
+      continue;
+    }
+    i = heap_pop(h, &left);
+    next = stream_peek(a);
+    if(next >= 0 && time + left > next){
+      heap_push(h, i, left - (next - time));
+      time = next;
+    }
+    else{
+      time += left;
+      wide_add(&best_sum, time - proc[i].arrivaltime);
+      done++;
+    }
+  }
+  best_makespan = time;
+
+  for(i = 0; i < num_processes; i++){
+    work += proc[i].runtime;
+    if(proc[i].arrivaltime + proc[i].runtime > last){
+      last = proc[i].arrivaltime + proc[i].runtime;
+    }
+  }
+  if(num_processes > 0 && first + work > last){
+    last = first + work;
+  }
+  printf("Least average time from arrival to finish is %lld seconds\n",
+         wide_div(best_sum, num_processes));
+  printf("Least makespan is %lld seconds, %lld of it idle, closed form bound %lld\n",
+         best_makespan, idle, last);
+
+  free(batch);
+  free_heap(h);
+  free_stream(a);
+}
+
+/* Jain's index over slowdowns (turnaround / runtime), 1 is perfectly fair */
+double jain(struct process *proc){
+  int i;
+  double slowdown, sum = 0, sum_sq = 0;
+  for(i = 0; i < num_processes; i++){
+    slowdown = (double)(proc[i].endtime - proc[i].arrivaltime) / proc[i].runtime;
+    sum += slowdown;
+    sum_sq += slowdown * slowdown;
+  }
+  return sum * sum / (num_processes * sum_sq);
+}
+
+void fairness(struct process *proc){
+  printf("Fairness of slowdowns is %.3f\n", jain(proc));
+}
+
+/*
+ * Cost model.  Every policy calls this as it gives the CPU to a job and
+ * adds the result to time before the job runs, so the overhead lands in
+ * turnaround.  Going on with the same job is free.  Otherwise there is
+ * switch_cost, plus warmup_cost when the job resumes after at least
+ * cache_jobs dispatches of others have pushed it out of the cache.
+ */
+int dispatch(struct process *proc, int id){
+  int cost = 0;
+  if(id != last_dispatched){
+    proc[id].runs++;
+    cost = switch_cost;
+    if(proc[id].lastrun > 0 && dispatches - proc[id].lastrun >= cache_jobs){
+      cost += warmup_cost;
+    }
+  }
+  dispatches++;
+  proc[id].lastrun = dispatches;
+  last_dispatched = id;
+  switch_lost += cost;
+  return cost;
+}
+
+int compare_int(const void *a, const void *b){
+  return *(const int*)a - *(const int*)b;
+}
+
+int compare_time(const void *a, const void *b){
+  long long x = *(const long long*)a, y = *(const long long*)b;
+  return x < y ? -1 : x > y;
+}
+
+/* Deadline misses, and how late the jobs that missed were */
+void deadlines(struct process *proc){
+  int i, count = 0, missed = 0;
+  long long *late = (long long*)malloc(num_processes * sizeof(long long));
+  for(i = 0; i < num_processes; i++){
+    if(proc[i].deadline > 0){
+      count++;
+      if(proc[i].endtime > proc[i].deadline){
+        late[missed++] = proc[i].endtime - proc[i].deadline;
+      }
+    }
+  }
+  if(count > 0){
+    printf("Missed %d of %d deadlines", missed, count);
+    if(missed > 0){
+      qsort(late, missed, sizeof(long long), compare_time);
+      printf(", lateness p50 %lld p90 %lld p99 %lld max %lld",
+             late[(missed - 1) * 50 / 100], late[(missed - 1) * 90 / 100],
+             late[(missed - 1) * 99 / 100], late[missed - 1]);
+    }
+    printf("\n");
+  }
+  free(late);
+}
+
+/* Proportional share shows as slowdown falling with the ticket count */
+void share_by_priority(struct process *proc){
+  int i, p, count;
+  double sum;
+  for(p = 0; p < 3; p++){
+    count = 0;
+    sum = 0;
+    for(i = 0; i < num_processes; i++){
+      if(proc[i].priority == p){
+        sum += (double)(proc[i].endtime - proc[i].arrivaltime) / proc[i].runtime;
+        count++;
+      }
+    }
+    if(count > 0){
+      printf("Priority %d (%d tickets) average slowdown is %.2f\n",
+             p, TICKETS << p, sum / count);
+    }
+  }
+}
+
+/*
+ * Workload and result files are column files, see utils.c.  A workload
+ * holds each process's arrival, runtime, priority, whether it has a
+ * deadline and how long after arrival it is.  A result holds each
+ * process's start, time from start to end and preemptions.
+ */
+#define WORKLOAD_MAGIC "SCHW"
+#define WORKLOAD_COLS 6     /* Files from before threads have 5, all single */
+#define RESULT_MAGIC "SCHR"
+#define RESULT_COLS 3
+
+unsigned char workload_kind[] = {COL_DELTA, COL_VARINT, COL_BITS, COL_BITS, COL_VARINT,
+                                 COL_VARINT};
+unsigned char workload_width[] = {0, 0, 2, 1, 0, 0};
+unsigned char result_kind[] = {COL_DELTA, COL_VARINT, COL_VARINT};
+unsigned char result_width[] = {0, 0, 0};
+
+long long **create_columns(int cols, long rows){
+  long long **column = (long long**)malloc(cols * sizeof(long long*));
+  int k;
+  for(k = 0; k < cols; k++){
+    column[k] = (long long*)malloc(rows * sizeof(long long));
+  }
+  return column;
+}
+
+void free_columns(long long **column, int cols){
+  int k;
+  for(k = 0; k < cols; k++){
+    free(column[k]);
+  }
+  free(column);
+}
+
+int write_workload(char *path, struct process *proc){
+  long long **column = create_columns(WORKLOAD_COLS, num_processes);
+  int i, status;
+  for(i = 0; i < num_processes; i++){
+    column[0][i] = proc[i].arrivaltime;
+    column[1][i] = proc[i].runtime;
+    column[2][i] = proc[i].priority;
+    column[3][i] = proc[i].deadline > 0;
+    column[4][i] = proc[i].deadline > 0 ? proc[i].deadline - proc[i].arrivaltime : 0;
+    column[5][i] = proc[i].threads;
+  }
+  status = col_write(path, WORKLOAD_MAGIC, WORKLOAD_COLS, workload_kind,
+                     workload_width, column, num_processes);
+  free_columns(column, WORKLOAD_COLS);
+  return status;
+}
+
+/* Sets num_processes and fills a new process table from the file */
+int read_workload(char *path, struct process **proc){
+  colfile *f = col_open(path, WORKLOAD_MAGIC);
+  long long **column;
+  int i;
+  if(f == NULL || f->cols < WORKLOAD_COLS - 1 || f->cols > WORKLOAD_COLS ||
+     f->rows < 1 || f->rows > INT_MAX){
+    printf("Can't read workload %s\n", path);
+    if(f != NULL){
+      col_close(f);
+    }
+    return 1;
+  }
+  num_processes = (int)f->rows;
+  *proc = (struct process*)calloc(num_processes, sizeof(struct process));
+  column = create_columns(WORKLOAD_COLS, num_processes);
+  col_read(f, column);
+  if(f->cols < WORKLOAD_COLS){
+    for(i = 0; i < num_processes; i++){
+      column[5][i] = 1;
+    }
+  }
+  col_close(f);
+  /* Slowdowns divide by the runtime, so every job needs some */
+  for(i = 0; i < num_processes; i++){
+    if(column[1][i] < 1){
+      printf("Workload %s has process %d with runtime %lld\n", path, i, column[1][i]);
+      free_columns(column, WORKLOAD_COLS);
+      free(*proc);
+      *proc = NULL;
+      return 1;
+    }
+  }
+  for(i = 0; *proc != NULL && i < num_processes; i++){
+    (*proc)[i].arrivaltime = column[0][i];
+    (*proc)[i].runtime = column[1][i];
+    (*proc)[i].priority = column[2][i];
+    (*proc)[i].tickets = TICKETS << column[2][i];
+    (*proc)[i].deadline = column[3][i] ? column[0][i] + column[4][i] : 0;
+    (*proc)[i].threads = column[5][i] < 1 ? 1 : column[5][i] > 65535 ? 65535 : column[5][i];
+  }
+  free_columns(column, WORKLOAD_COLS);
+  return 0;
+}
+
+/* One file a policy, prefix.name */
+int write_results(char *prefix, char *name, struct process *proc){
+  long long **column = create_columns(RESULT_COLS, num_processes);
+  char *path = (char*)malloc(strlen(prefix) + strlen(name) + 2);
+  int i, status;
+  sprintf(path, "%s.%s", prefix, name);
+  for(i = 0; i < num_processes; i++){
+    column[0][i] = proc[i].starttime;
+    column[1][i] = proc[i].endtime - proc[i].starttime;
+    column[2][i] = proc[i].runs > 0 ? proc[i].runs - 1 : 0;
+  }
+  status = col_write(path, RESULT_MAGIC, RESULT_COLS, result_kind, result_width,
+                     column, num_processes);
+  free_columns(column, RESULT_COLS);
+  free(path);
+  return status;
+}
+
+int dump_file(char *path){
+  colfile *f = col_open(path, WORKLOAD_MAGIC);
+  int workload = f != NULL;
+  long long **column;
+  long i;
+  if(f == NULL){
+    f = col_open(path, RESULT_MAGIC);
+  }
+  if(f == NULL || (workload ? f->cols < WORKLOAD_COLS - 1 || f->cols > WORKLOAD_COLS
+                            : f->cols != RESULT_COLS)){
+    printf("%s is not a workload or result file\n", path);
+    return 1;
+  }
+  column = create_columns(f->cols, f->rows);
+  col_read(f, column);
+  if(workload){
+    printf("Process\tarrival\truntime\tpriority\tdeadline\tthreads\n");
+    for(i = 0; i < f->rows; i++){
+      printf("%ld\t%lld\t%lld\t%lld\t%lld\t%lld\n", i, column[0][i], column[1][i],
+             column[2][i], column[3][i] ? column[0][i] + column[4][i] : 0,
+             f->cols < WORKLOAD_COLS ? 1 : column[5][i]);
+    }
+  }
+  else{
+    printf("Process\tstart\tend\tpreemptions\n");
+    for(i = 0; i < f->rows; i++){
+      printf("%ld\t%lld\t%lld\t%lld\n", i, column[0][i], column[0][i] + column[1][i],
+             column[2][i]);
+    }
+  }
+  free_columns(column, f->cols);
+  col_close(f);
+  return 0;
+}
+
+/*
+ * Result cache.  A run is keyed by a hash of the workload, the policy and
+ * every setting that changes what it prints, and kept as key.out, the
+ * text it printed, and key.col, its schedule.  A hit prints the text and
+ * puts the schedule back, so the statistics and result files after it
+ * come out the same.  The least recently used entries go once the cache
+ * passes cache_limit bytes.
+ */
+#define CACHE_VERSION 4     /* Bump when any policy's schedule changes */
+#define CACHE_MAGIC "SCHC"
+#define CACHE_COLS 3
+
+unsigned char cache_kind[] = {COL_DELTA, COL_VARINT, COL_VARINT};
+unsigned char cache_width[] = {0, 0, 0};
+
+void hash_workload(struct process *proc){
+  int i;
+  hash_init(&workload_hash);
+  for(i = 0; i < num_processes; i++){
+    hash_word(&workload_hash, proc[i].arrivaltime);
+    hash_word(&workload_hash, proc[i].runtime);
+    hash_word(&workload_hash, proc[i].deadline);
+    hash_word(&workload_hash, proc[i].priority);
+    hash_word(&workload_hash, proc[i].threads);
+  }
+}
+
+/* 32 hex digits for this workload under policy name and the settings */
+void cache_key(char *name, char *key){
+  hash128 h = workload_hash;
+  hash_word(&h, CACHE_VERSION);
+  hash_word(&h, num_processes);
+  hash_word(&h, quiet);
+  hash_word(&h, show_bounds);
+  hash_word(&h, target_latency);
+  hash_word(&h, min_granularity);
+  hash_word(&h, switch_cost);
+  hash_word(&h, warmup_cost);
+  hash_word(&h, cache_jobs);
+  hash_word(&h, quantum);
+  hash_word(&h, cpus);
+  hash_word(&h, TICKETS);
+  hash_word(&h, STRIDE1);
+  hash_bytes(&h, name, strlen(name));
+  hash_hex(&h, key);
+}
+
+/* Names the cache writes: key.out, key.col and their .pid temporaries */
+int cache_name(const char *name){
+  int i;
+  for(i = 0; i < 32; i++){
+    if(!((name[i] >= '0' && name[i] <= '9') || (name[i] >= 'a' && name[i] <= 'f'))){
+      return 0;
+    }
+  }
+  name += 32;
+  if(strncmp(name, ".out", 4) != 0 && strncmp(name, ".col", 4) != 0){
+    return 0;
+  }
+  name += 4;
+  if(*name == '.'){
+    for(name++; *name >= '0' && *name <= '9'; name++);
+    return name[-1] != '.' && *name == '\0';
+  }
+  return *name == '\0';
+}
+
+char *cache_path(char *key, char *ext){
+  char *path = (char*)malloc(strlen(cache_dir) + strlen(key) + strlen(ext) + 2);
+  sprintf(path, "%s/%s%s", cache_dir, key, ext);
+  return path;
+}
+
+/* Copies the rest of in to out */
+void copy_file(FILE *in, FILE *out){
+  char buf[65536];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), in)) > 0){
+    fwrite(buf, 1, n, out);
+  }
+}
+
+/* On a hit prints the stored text, restores the schedule and returns 1 */
+int cache_load(char *key, struct process *proc){
+  char *col = cache_path(key, ".col"), *text = cache_path(key, ".out");
+  colfile *f = col_open(col, CACHE_MAGIC);
+  FILE *in = f != NULL ? fopen(text, "r") : NULL;
+  long long **column;
+  int i, hit = 0;
+
+  if(in != NULL && f->cols == CACHE_COLS && f->rows == num_processes){
+    copy_file(in, stdout);
+    column = create_columns(CACHE_COLS, num_processes);
+    col_read(f, column);
+    for(i = 0; i < num_processes; i++){
+      proc[i].starttime = column[0][i];
+      proc[i].endtime = column[0][i] + column[1][i];
+      proc[i].runs = (int)column[2][i];
+    }
+    free_columns(column, CACHE_COLS);
+    /* Touched, so it's the last to go */
+    utime(col, NULL);
+    utime(text, NULL);
+    hit = 1;
+  }
+  if(in != NULL){
+    fclose(in);
+  }
+  if(f != NULL){
+    col_close(f);
+  }
+  free(col);
+  free(text);
+  return hit;
+}
+
+/* Starts catching what the run prints, NULL if it can't */
+FILE *cache_begin(char *key, capture *c){
+  char ext[32];
+  char *path;
+  FILE *out;
+  sprintf(ext, ".out.%d", (int)getpid());
+  path = cache_path(key, ext);
+  out = fopen(path, "w+");
+  free(path);
+  if(out != NULL && capture_begin(c, out) != 0){
+    fclose(out);
+    out = NULL;
+  }
+  return out;
+}
+
+/*
+ * Prints what the run printed and files it with the schedule.  Both go in
+ * under temporary names, the text first, so a reader never sees a
+ * schedule without its text.
+ */
+void cache_store(char *key, capture *c, FILE *out, struct process *proc){
+  char ext[32];
+  char *text_tmp, *col_tmp, *text, *col;
+  long long **column = create_columns(CACHE_COLS, num_processes);
+  struct stat st;
+  long long size;
+  int i;
+
+  capture_end(c);
+  rewind(out);
+  copy_file(out, stdout);
+  size = ftell(out);
+  fclose(out);
+
+  sprintf(ext, ".out.%d", (int)getpid());
+  text_tmp = cache_path(key, ext);
+  sprintf(ext, ".col.%d", (int)getpid());
+  col_tmp = cache_path(key, ext);
+  text = cache_path(key, ".out");
+  col = cache_path(key, ".col");
+  for(i = 0; i < num_processes; i++){
+    column[0][i] = proc[i].starttime;
+    column[1][i] = proc[i].endtime - proc[i].starttime;
+    column[2][i] = proc[i].runs;
+  }
+  if(col_write(col_tmp, CACHE_MAGIC, CACHE_COLS, cache_kind, cache_width,
+               column, num_processes) == 0 && stat(col_tmp, &st) == 0 &&
+     size + st.st_size <= cache_limit &&
+     rename(text_tmp, text) == 0 && rename(col_tmp, col) == 0){
+    dir_trim(cache_dir, cache_limit, cache_name);
+  }
+  unlink(text_tmp);
+  unlink(col_tmp);
+  free_columns(column, CACHE_COLS);
+  free(text_tmp);
+  free(col_tmp);
+  free(text);
+  free(col);
+}
+
+/*
+ * Sweeps, -S seeds: every policy, or the one given, at every quantum
+ * given with -Q, on workloads drawn from SEED, SEED + 1 and on.  Policies
+ * that don't run in slices ignore the quantum, so run once a seed.  The runs
+ * are cut into shards handed to forked workers, -j of them, so a run
+ * that crashes takes down only its own shard, which is run again.  Each
+ * run writes one fixed size record into shared memory and the
+ * coordinator folds records into per policy and quantum totals as they
+ * land.  Runs go seed by seed, so a worker draws each workload once.
+ */
+#define SWEEP_TRIES 3       /* Runs of a shard before it counts as lost */
+#define SHARDS_PER_WORKER 4 /* Smaller shards lose less to a crash */
+
+/* What a worker writes for one run, done set last */
+typedef struct sweep_record{
+  wide sum;                 /* Turnarounds */
+  long long makespan;
+  long long worst;          /* Longest turnaround */
+  long lost;                /* switch_lost */
+  double fairness;
+  int dispatches;
+  int done;
+}sweep_record;
+
+typedef struct sweep{
+  int seeds;
+  int *policy;              /* Indices into policies */
+  int policy_count;
+  int cells;                /* Per seed, one per quantum if sliced */
+  int *cell_policy;         /* Index into policies of each cell */
+  int *cell_quantum;        /* Index into quanta, -1 if not sliced */
+  int runs, shards;
+  sweep_record *record;     /* Shared with the workers */
+  int *cursor;              /* Each shard's next record to fold */
+  int *folded;              /* Per cell of policy and quantum */
+  double *average, *best, *worst, *fairness, *lost;
+}sweep;
+
+int shard_from(sweep *w, int shard){
+  return (int)((long)w->runs * shard / w->shards);
+}
+
+/* Parses a comma separated list of quanta, 0 if it doesn't */
+int parse_quanta(char *text){
+  char *end;
+  quantum_count = 0;
+  while(quantum_count < MAX_QUANTA){
+    quanta[quantum_count] = (int)strtol(text, &end, 10);
+    if(end == text || quanta[quantum_count] < 1 || (*end != ',' && *end != '\0')){
+      return 0;
+    }
+    quantum_count++;
+    if(*end == '\0'){
+      break;
+    }
+    text = end + 1;
+  }
+  quantum = quanta[0];
+  return *end == '\0';
+}
+
+/* In a worker: runs the shard's configurations still without a record */
+void sweep_work(int shard, void *arg){
+  sweep *w = (sweep*)arg;
+  struct process *proc = (struct process*)malloc(num_processes * sizeof(struct process));
+  struct process *copy = (struct process*)malloc(num_processes * sizeof(struct process));
+  int c, seed, drawn = -1, cell, i;
+  sweep_record *r;
+  long long min;
+
+  if(proc == NULL || copy == NULL || freopen("/dev/null", "w", stdout) == NULL){
+    _exit(1);
+  }
+  quiet = 1;
+  show_bounds = 0;
+  bounded = 0;
+  keep_trace = 0;
+  for(c = shard_from(w, shard); c < shard_from(w, shard + 1); c++){
+    r = &w->record[c];
+    if(r->done){
+      continue;
+    }
+    seed = c / w->cells;
+    cell = c % w->cells;
+    if(seed != drawn){
+      generate(proc, SEED + seed);
+      drawn = seed;
+    }
+    memcpy(copy, proc, num_processes * sizeof(struct process));
+    quantum = quanta[w->cell_quantum[cell] < 0 ? 0 : w->cell_quantum[cell]];
+    switch_lost = 0;
+    dispatches = 0;
+    last_dispatched = -1;
+    policies[w->cell_policy[cell]].run(copy);
+
+    vec_span(&copy[0].endtime, &copy[0].arrivaltime, num_processes,
+             sizeof(struct process) / sizeof(long long), &r->sum, &min, &r->worst);
+    r->makespan = 0;
+    for(i = 0; i < num_processes; i++){
+      if(copy[i].endtime > r->makespan){
+        r->makespan = copy[i].endtime;
+      }
+    }
+    r->fairness = jain(copy);
+    r->lost = switch_lost;
+    r->dispatches = dispatches;
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+  }
+  fflush(stdout);
+  free(proc);
+  free(copy);
+}
+
+/* In the coordinator: folds in every record landed since the last call */
+void sweep_poll(void *arg){
+  sweep *w = (sweep*)arg;
+  int s, c, cell;
+  double average;
+  sweep_record *r;
+
+  for(s = 0; s < w->shards; s++){
+    for(c = w->cursor[s]; c < shard_from(w, s + 1); c++){
+      r = &w->record[c];
+      if(!__atomic_load_n(&r->done, __ATOMIC_ACQUIRE)){
+        break;
+      }
+      cell = c % w->cells;
+      average = wide_double(r->sum) / num_processes;
+      if(w->folded[cell] == 0 || average < w->best[cell]){
+        w->best[cell] = average;
+      }
+      if(w->folded[cell] == 0 || average > w->worst[cell]){
+        w->worst[cell] = average;
+      }
+      w->average[cell] += average;
+      w->fairness[cell] += r->fairness;
+      w->lost[cell] += r->lost;
+      w->folded[cell]++;
+    }
+    w->cursor[s] = c;
+  }
+}
+
+int run_sweep(int seeds, int workers, char *name){
+  sweep w;
+  int p, q, cell, failed, total = 0;
+  char label[16];
+  struct timespec t0, t1;
+
+  w.seeds = seeds;
+  w.policy = (int*)malloc(sizeof(policies) / sizeof(policies[0]) * sizeof(int));
+  w.policy_count = 0;
+  for(p = 0; policies[p].name != NULL; p++){
+    if(name == NULL || strcmp(name, policies[p].name) == 0){
+      w.policy[w.policy_count++] = p;
+    }
+  }
+  if(w.policy_count == 0){
+    printf("No policy %s\n", name);
+    free(w.policy);
+    return 1;
+  }
+  w.cells = 0;
+  for(p = 0; p < w.policy_count; p++){
+    w.cells += policies[w.policy[p]].sliced ? quantum_count : 1;
+  }
+  w.cell_policy = (int*)malloc(w.cells * sizeof(int));
+  w.cell_quantum = (int*)malloc(w.cells * sizeof(int));
+  for(p = 0, cell = 0; p < w.policy_count; p++){
+    for(q = 0; q < (policies[w.policy[p]].sliced ? quantum_count : 1); q++, cell++){
+      w.cell_policy[cell] = w.policy[p];
+      w.cell_quantum[cell] = policies[w.policy[p]].sliced ? q : -1;
+    }
+  }
+  if((long)seeds * w.cells > INT_MAX){
+    printf("Too many runs in the sweep\n");
+    free(w.policy);
+    free(w.cell_policy);
+    free(w.cell_quantum);
+    return 1;
+  }
+  w.runs = seeds * w.cells;
+  w.shards = workers * SHARDS_PER_WORKER < w.runs ? workers * SHARDS_PER_WORKER : w.runs;
+  w.record = (sweep_record*)shared_region((long)w.runs * sizeof(sweep_record));
+  if(w.record == NULL){
+    printf("Can't map %d sweep records\n", w.runs);
+    free(w.policy);
+    free(w.cell_policy);
+    free(w.cell_quantum);
+    return 1;
+  }
+  w.cursor = (int*)malloc(w.shards * sizeof(int));
+  for(p = 0; p < w.shards; p++){
+    w.cursor[p] = shard_from(&w, p);
+  }
+  w.folded = (int*)calloc(w.cells, sizeof(int));
+  w.average = (double*)calloc(w.cells, sizeof(double));
+  w.best = (double*)calloc(w.cells, sizeof(double));
+  w.worst = (double*)calloc(w.cells, sizeof(double));
+  w.fairness = (double*)calloc(w.cells, sizeof(double));
+  w.lost = (double*)calloc(w.cells, sizeof(double));
+
+  printf("Sweep of %d seeds, %d policies, %d quanta: %d runs of %d processes "
+         "on %d workers\n", seeds, w.policy_count, quantum_count, w.runs,
+         num_processes, workers);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  failed = fork_shards(w.shards, workers, SWEEP_TRIES, sweep_work, sweep_poll, &w);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("policy\tquantum\truns\taverage\tbest\tworst\tfairness\tswitching\n");
+  for(cell = 0; cell < w.cells; cell++){
+    q = w.cell_quantum[cell];
+    if(q < 0){
+      strcpy(label, "-");
+    }
+    else{
+      snprintf(label, sizeof(label), "%d", quanta[q]);
+    }
+    total += w.folded[cell];
+    if(w.folded[cell] == 0){
+      printf("%s\t%s\t0\n", policies[w.cell_policy[cell]].name, label);
+      continue;
+    }
+    printf("%s\t%s\t%d\t%.1f\t%.1f\t%.1f\t%.3f\t\t%.1f\n",
+           policies[w.cell_policy[cell]].name, label, w.folded[cell],
+           w.average[cell] / w.folded[cell], w.best[cell], w.worst[cell],
+           w.fairness[cell] / w.folded[cell], w.lost[cell] / w.folded[cell]);
+  }
+  if(failed > 0){
+    printf("Lost %d of %d runs, %d shards failed %d times\n", w.runs - total,
+           w.runs, failed, SWEEP_TRIES);
+  }
+  if(quiet){
+    printf("Sweep took %.3f seconds\n",
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+  }
+
+  free_shared_region(w.record, (long)w.runs * sizeof(sweep_record));
+  free(w.policy);
+  free(w.cell_policy);
+  free(w.cell_quantum);
+  free(w.cursor);
+  free(w.folded);
+  free(w.average);
+  free(w.best);
+  free(w.worst);
+  free(w.fairness);
+  free(w.lost);
+  return failed > 0;
+}
+
+/*
+ * The non-preemptive policies share one engine.  Ready jobs sit in slots
+ * in the order they were queued, with a key column that is LLONG_MAX in
+ * the slots of jobs already run.  fcfs takes the first live slot, srt the
+ * first shortest, a vector scan over runtimes that breaks ties the way
+ * the sorted queue did, to the job queued first.  Jobs that arrive
+ * together queue in arrival order for fcfs and index order for srt, as
+ * the old scan did.
+ *
+ * Asked to, a run keeps a trace for what-if questions: each job's
+ * dispatch number and the time and dispatch count it was queued at, and
+ * every CHECKPOINT_EVERY dispatches the state at the top of the loop.  A
+ * checkpoint is O(1): time, cursor, a hash of the live jobs and their
+ * queue times, and the cost model's state.  The live slots at one are the
+ * arrivals before its cursor not yet dispatched, which a max tree of
+ * dispatch numbers by stream position finds in O(log n) each.
+ */
+#define CHECKPOINT_EVERY 64
+
+typedef struct checkpoint{
+  long long time;
+  long cursor;              /* Arrivals handed out */
+  unsigned long long live;  /* Hash of the queued jobs and their queue times */
+  int last;                 /* last_dispatched */
+  long lost;                /* switch_lost */
+}checkpoint;
+
+typedef struct np_trace{
+  int shortest;
+  stream *a;                /* The run's arrivals, kept */
+  int *seq;                 /* Dispatch number of each job */
+  long long *queued;        /* Time each job was queued */
+  int *queued_done;         /* Dispatches before it was queued */
+  checkpoint *cp;           /* cp[c] is at c * CHECKPOINT_EVERY dispatches */
+  int checkpoints;
+  maxtree *pending;         /* Dispatch number of each arrival, by position */
+}np_trace;
+
+np_trace *trace = NULL;   /* Of the last non-preemptive run */
+
+typedef struct np_engine{
+  struct process *proc;
+  int shortest;
+  stream *a;
+  int *batch;
+  long long *key;           /* Runtime for srt, 0 for fcfs, LLONG_MAX once run */
+  int *id;
+  long long *queued;        /* Time each job was queued */
+  long used, live, first;
+  long long time;
+  int done;                 /* Jobs dispatched */
+  int marked;               /* Last dispatch count a checkpoint was at */
+  unsigned long long hash;  /* Of the live jobs and their queue times */
+}np_engine;
+
+unsigned long long np_live_hash(int id, long long queued){
+  return hash_mix((unsigned long long)id * 0x9E3779B97F4A7C15ULL + queued);
+}
+
+/* Puts job i in the next slot, its queue time already set */
+void np_slot(np_engine *e, int i){
+  e->key[e->used] = e->shortest ? e->proc[i].runtime : 0;
+  e->id[e->used++] = i;
+  e->live++;
+  e->hash += np_live_hash(i, e->queued[i]);
+}
+
+/* Queues what has arrived by now */
+void np_queue(np_engine *e, np_trace *t){
+  int i, k, count = stream_advance(e->a, e->time, e->batch);
+  if(e->shortest && count > 1){
+    qsort(e->batch, count, sizeof(int), compare_int);
+  }
+  for(k = 0; k < count; k++){
+    i = e->batch[k];
+    e->proc[i].flag = 1;
+    e->queued[i] = e->time;
+    np_slot(e, i);
+    if(t != NULL){
+      t->queued_done[i] = e->done;
+    }
+  }
+}
+
+/* Takes the next job out of its slot */
+int np_pick(np_engine *e){
+  long slot;
+  int i;
+  if(e->shortest){
+    slot = vec_first_min(e->key, e->used);
+  }
+  else{
+    while(e->key[e->first] == LLONG_MAX){
+      e->first++;
+    }
+    slot = e->first;
+  }
+  i = e->id[slot];
+  e->key[slot] = LLONG_MAX;
+  e->live--;
+  e->hash -= np_live_hash(i, e->queued[i]);
+
+  /* Once most slots are spent, close them up, keeping the order */
+  if(e->used > 2 * e->live + 64){
+    long kept = 0;
+    for(slot = 0; slot < e->used; slot++){
+      if(e->key[slot] != LLONG_MAX){
+        e->key[kept] = e->key[slot];
+        e->id[kept++] = e->id[slot];
+      }
+    }
+    e->used = kept;
+    e->first = 0;
+  }
+  return i;
+}
+
+np_engine *create_np_engine(struct process *proc, int shortest, stream *a){
+  np_engine *e = (np_engine*)calloc(1, sizeof(np_engine));
+  e->proc = proc;
+  e->shortest = shortest;
+  e->a = a;
+  e->batch = (int*)malloc(num_processes * sizeof(int));
+  e->key = (long long*)malloc(num_processes * sizeof(long long));
+  e->id = (int*)malloc(num_processes * sizeof(int));
+  e->queued = (long long*)malloc(num_processes * sizeof(long long));
+  e->marked = -1;
+  return e;
+}
+
+void free_np_engine(np_engine *e){
+  free(e->batch);
+  free(e->key);
+  free(e->id);
+  free(e->queued);
+  free(e);
+}
+
+void free_trace(np_trace *t){
+  free_stream(t->a);
+  free(t->seq);
+  free(t->queued);
+  free(t->queued_done);
+  free(t->cp);
+  free_maxtree(t->pending);
+  free(t);
+}
+
+void drop_trace(){
+  if(trace != NULL){
+    free_trace(trace);
+    trace = NULL;
+  }
+}
+
+void non_preemptive(struct process *proc, int shortest){
+  stream *a = arrivals(proc);
+  np_engine *e = create_np_engine(proc, shortest, a);
+  np_trace *t = NULL;
+  int i;
+
+  if(keep_trace){
+    t = (np_trace*)malloc(sizeof(np_trace));
+    t->shortest = shortest;
+    t->a = a;
+    t->seq = (int*)malloc(num_processes * sizeof(int));
+    t->queued = e->queued;
+    t->queued_done = (int*)malloc(num_processes * sizeof(int));
+    t->cp = (checkpoint*)malloc((num_processes / CHECKPOINT_EVERY + 1) * sizeof(checkpoint));
+    t->checkpoints = 0;
+  }
+
+  while(e->done < num_processes){
+    if(t != NULL && e->done % CHECKPOINT_EVERY == 0 && e->done != e->marked){
+      checkpoint *c = &t->cp[t->checkpoints++];
+      e->marked = e->done;
+      c->time = e->time;
+      c->cursor = a->next;
+      c->live = e->hash;
+      c->last = last_dispatched;
+      c->lost = switch_lost;
+    }
+    np_queue(e, t);
+    if(e->live == 0){
+      e->time = stream_peek(a);
+      continue;
+    }
+    i = np_pick(e);
+    if(t != NULL){
+      t->seq[i] = e->done;
+    }
+    e->done++;
+    e->time += dispatch(proc, i);
+    report_start(i, e->time);
+    proc[i].starttime = e->time;
+    e->time += proc[i].runtime;
+    report_finish(i, e->time);
+    proc[i].endtime = e->time;
+  }
+  average_time(proc);
+
+  if(t != NULL){
+    t->pending = create_maxtree(num_processes);
+    for(i = 0; i < num_processes; i++){
+      maxtree_set(t->pending, i, t->seq[a->item[i].id]);
+    }
+  }
+  drop_trace();
+  trace = t;
+  if(t == NULL){
+    free_stream(a);
+  }
+  else{
+    e->queued = NULL;       /* The trace's now */
+  }
+  free_np_engine(e);
+}
+
+void first_come_first_served(struct process *proc){
+  non_preemptive(proc, 0);
+}
+
+void shortest_remaining_time(struct process *proc){
+  non_preemptive(proc, 1);
+}
+
+/* Parses id=runtime[,id=runtime...], 0 if it doesn't */
+int parse_question(char *text, question *q){
+  char *p = text, *end;
+  q->text = text;
+  q->edits = 0;
+  while(*p != '\0' && q->edits < MAX_EDITS){
+    q->id[q->edits] = (int)strtol(p, &end, 10);
+    if(end == p || *end != '='){
+      return 0;
+    }
+    p = end + 1;
+    q->runtime[q->edits] = strtoll(p, &end, 10);
+    if(end == p || q->runtime[q->edits] < 0 || (*end != ',' && *end != '\0')){
+      return 0;
+    }
+    q->edits++;
+    p = *end == ',' ? end + 1 : end;
   }
+  return q->edits > 0 && *p == '\0';
+}
 
-  /* Show process values */
-  printf("Process\tarrival\truntime\tpriority\n");
-  for(i=0; i<NUM_PROCESSES; i++)
-    printf("%d\t%d\t%d\t%d\n", i, proc[i].arrivaltime, proc[i].runtime,
-           proc[i].priority);
-
-  /* Run scheduling algorithms */
-  printf("\n\nFirst come first served\n");
-  memcpy(proc_copy, proc, NUM_PROCESSES * sizeof(struct process));
-  first_come_first_served(proc_copy);
+/* Swaps the question's runtimes in, or back out, returns 0 if an id is bad */
+int apply_question(question *q, struct process *proc, long long *saved, int in){
+  int k;
+  for(k = 0; k < q->edits; k++){
+    if(q->id[k] < 0 || q->id[k] >= num_processes){
+      return 0;
+    }
+  }
+  if(in){
+    for(k = 0; k < q->edits; k++){
+      saved[k] = proc[q->id[k]].runtime;
+      proc[q->id[k]].runtime = q->runtime[k];
+    }
+  }
+  else{
+    for(k = q->edits - 1; k >= 0; k--){
+      proc[q->id[k]].runtime = saved[k];
+    }
+  }
+  return 1;
+}
 
-  printf("\n\nShortest remaining time\n");
-  memcpy(proc_copy, proc, NUM_PROCESSES * sizeof(struct process));
-  shortest_remaining_time(proc_copy);
-  
-  printf("\n\nRound Robin\n");
-  memcpy(proc_copy, proc, NUM_PROCESSES * sizeof(struct process));
-  round_robin(proc_copy);
+/* A job the edits moved */
+typedef struct move{
+  int id;
+  long long start, end;
+}move;
 
-  printf("\n\nRound Robin with priority\n");
-  memcpy(proc_copy, proc, NUM_PROCESSES * sizeof(struct process));
-  round_robin_priority(proc_copy);
+int compare_move(const void *a, const void *b){
+  return ((move*)a)->id - ((move*)b)->id;
+}
 
-  return 0;
+/* Prints the answer from the run and the jobs that moved, reran -1 if all */
+void answer(question *q, struct process *base, int reran, move *moved, int count){
+  wide sum;
+  long long min, max;
+  int k;
+  vec_span(&base[0].endtime, &base[0].arrivaltime, num_processes,
+           sizeof(struct process) / sizeof(long long), &sum, &min, &max);
+  for(k = 0; k < count; k++){
+    wide_add(&sum, moved[k].end - base[moved[k].id].endtime);
+  }
+  qsort(moved, count, sizeof(move), compare_move);
+  if(reran < 0){
+    printf("What if runtime %s: ran again in full\n", q->text);
+  }
+  else{
+    printf("What if runtime %s: reran %d of %d dispatches\n", q->text, reran,
+           num_processes);
+  }
+  printf("Average time from arrival to finish is %lld seconds\n",
+         wide_div(sum, num_processes));
+  for(k = 0; !quiet && k < count; k++){
+    printf("Process %d now starts at time %lld and finishes at time %lld\n",
+           moved[k].id, moved[k].start, moved[k].end);
+  }
 }
 
+/*
+ * Reruns from the last checkpoint before the edits can matter: for srt
+ * before the first edited job was queued, since its runtime counts from
+ * then, for fcfs before it ran.  Stops at the first later checkpoint
+ * after every edited job has run where the state is the trace's again,
+ * as from there the run would go as it went.
+ */
+void np_whatif(struct process *proc, question *q){
+  np_trace *t = trace;
+  np_engine *e = create_np_engine(proc, t->shortest, t->a);
+  long long saved[MAX_EDITS];
+  move *moved = (move*)malloc(num_processes * sizeof(move));
+  int i, k, c, runs, lastrun, from = num_processes, pending, count = 0, reran = 0;
+  long s, run;
+  checkpoint *cp;
 
-void average_time(struct process *proc){
-  int i, avrg = 0;
-  for(i = 0; i < NUM_PROCESSES; i++){
-    avrg += proc[i].endtime - proc[i].arrivaltime;
+  if(!apply_question(q, proc, saved, 1)){
+    printf("What if runtime %s: no such process\n", q->text);
+    free_np_engine(e);
+    free(moved);
+    return;
   }
-  avrg = avrg / NUM_PROCESSES;
-  printf("Average time from arrival to finish is %d seconds\n", avrg);
-}
+  for(k = 0; k < q->edits; k++){
+    i = q->id[k];
+    if((t->shortest ? t->queued_done[i] : t->seq[i]) < from){
+      from = t->shortest ? t->queued_done[i] : t->seq[i];
+    }
+  }
+  c = from / CHECKPOINT_EVERY;
+  cp = &t->cp[c];
 
-void first_come_first_served(struct process *proc){
-  int i, time = 0, finished = 0;
-  int flag_count = 0;
-  queue *q = create_queue();
-  
-  while(flag_count < NUM_PROCESSES){
-    while(q->size != 0){
-      node *n = dequeue(q);
-      i = n->id;
-      proc[i].starttime = time;
-      printf("Process %d started at time %d\n", i, time);
-      time += proc[i].runtime;
-      proc[i].endtime = time;
-      printf("Process %d finished at time %d\n", i, time);
-      free(n);
-      flag_count++;
+  /*
+   * Back to the checkpoint.  The live jobs come out of the tree in queue
+   * order, and for srt each batch queued together goes by id again.
+   */
+  e->done = c * CHECKPOINT_EVERY;
+  e->marked = e->done;
+  e->time = cp->time;
+  t->a->next = cp->cursor;
+  count = 0;
+  for(s = maxtree_next(t->pending, 0, e->done); s >= 0 && s < cp->cursor;
+      s = maxtree_next(t->pending, s + 1, e->done)){
+    e->batch[count++] = t->a->item[s].id;
+  }
+  for(s = 0; s < count; s = run){
+    for(run = s + 1; run < count &&
+        t->queued[e->batch[run]] == t->queued[e->batch[s]]; run++);
+    if(t->shortest && run - s > 1){
+      qsort(e->batch + s, run - s, sizeof(int), compare_int);
     }
-    for(i = 0; i < NUM_PROCESSES; i++){
-      if(!proc[i].flag && proc[i].arrivaltime <= time){
-        proc[i].flag = 1;
-        node *n = create_node(i, proc[i].arrivaltime);        
-        enqueue_time(q, n);
+    for(k = s; k < run; k++){
+      e->queued[e->batch[k]] = t->queued[e->batch[k]];
+      np_slot(e, e->batch[k]);
+    }
+  }
+  count = 0;
+  last_dispatched = cp->last;
+  switch_lost = cp->lost;
+  dispatches = e->done;
+
+  /* Each job can be edited more than once, count them once */
+  pending = 0;
+  for(k = 0; k < q->edits; k++){
+    for(i = 0; i < k && q->id[i] != q->id[k]; i++);
+    pending += i == k;
+  }
+
+  while(e->done < num_processes){
+    if(e->done % CHECKPOINT_EVERY == 0 && e->done != e->marked){
+      e->marked = e->done;
+      cp = &t->cp[e->done / CHECKPOINT_EVERY];
+      if(pending == 0 && e->time == cp->time && t->a->next == cp->cursor &&
+         e->hash == cp->live && last_dispatched == cp->last &&
+         switch_lost == cp->lost){
+        break;
       }
     }
-    if(q->size == 0){
-      time++;
+    np_queue(e, NULL);
+    if(e->live == 0){
+      e->time = stream_peek(t->a);
+      continue;
+    }
+    i = np_pick(e);
+    e->done++;
+    reran++;
+    for(k = 0; k < q->edits; k++){
+      if(q->id[k] == i){
+        pending--;
+        break;
+      }
+    }
+    /* Each job runs once, from cold, and the baseline keeps its counts */
+    runs = proc[i].runs;
+    lastrun = proc[i].lastrun;
+    proc[i].lastrun = 0;
+    e->time += dispatch(proc, i);
+    proc[i].runs = runs;
+    proc[i].lastrun = lastrun;
+    if(e->time != proc[i].starttime || e->time + proc[i].runtime != proc[i].endtime){
+      moved[count].id = i;
+      moved[count].start = e->time;
+      moved[count++].end = e->time + proc[i].runtime;
     }
+    e->time += proc[i].runtime;
   }
-  average_time(proc);
+
+  apply_question(q, proc, saved, 0);
+  answer(q, proc, reran, moved, count);
+  free_np_engine(e);
+  free(moved);
 }
 
-void shortest_remaining_time(struct process *proc){
-  int i, time = 0;
-  int flag_count = 0;
-  queue *q = create_queue();
+/*
+ * Any other policy answers by running again from the workload with the
+ * edits made, quietly and into /dev/null, then comparing with the run.
+ * The cost model's counts are put back for the run's own output.
+ */
+void whatif_rerun(struct policy *p, struct process *base, struct process *proc,
+                  question *q){
+  struct process *edited = (struct process*)malloc(num_processes * sizeof(struct process));
+  long long saved[MAX_EDITS];
+  move *moved = (move*)malloc(num_processes * sizeof(move));
+  int i, count = 0, was_quiet = quiet, was_last = last_dispatched;
+  int was_dispatches = dispatches;
+  long was_lost = switch_lost;
+  FILE *null = fopen("/dev/null", "w");
+  capture cap;
 
-  while(flag_count < NUM_PROCESSES){
-    for(i = 0; i < NUM_PROCESSES; i++){
-      if(proc[i].arrivaltime <= time && !proc[i].flag){
-        proc[i].flag = 1;
-        node *n = create_node(i, proc[i].runtime);
-        enqueue_runtime(q, n);
-        flag_count++;
-      }
-    }
-    // print_queue(q);
-    if(q->size == 0){
-      time++;
+  memcpy(edited, base, num_processes * sizeof(struct process));
+  if(null == NULL || !apply_question(q, edited, saved, 1)){
+    printf("What if runtime %s: %s\n", q->text,
+           null == NULL ? "can't open /dev/null" : "no such process");
+  }
+  else{
+    for(i = 0; i < q->edits; i++){
+      edited[q->id[i]].remainingtime = q->runtime[i];
     }
-    else{
-      node *n = dequeue(q);
-      int id = n->id;
-      printf("Process %d started at time %d\n", id, time);
-      proc[id].starttime = time;
-      time += proc[id].runtime;
-      printf("Process %d finished at time %d\n", id, time);
-      proc[id].endtime = time;
-      free(n);
+    quiet = 1;
+    keep_trace = 0;
+    switch_lost = 0;
+    dispatches = 0;
+    last_dispatched = -1;
+    capture_begin(&cap, null);
+    p->run(edited);
+    capture_end(&cap);
+    keep_trace = 1;
+    quiet = was_quiet;
+    for(i = 0; i < num_processes; i++){
+      if(edited[i].starttime != proc[i].starttime || edited[i].endtime != proc[i].endtime){
+        moved[count].id = i;
+        moved[count].start = edited[i].starttime;
+        moved[count++].end = edited[i].endtime;
+      }
     }
+    answer(q, proc, -1, moved, count);
   }
-  while(q->size > 0){
-    node *n = dequeue(q);
-    int id = n->id;
-    printf("Process %d started at time %d\n", id, time);
-    proc[id].starttime = time;
-    time += proc[id].runtime;
-    printf("Process %d finished at time %d\n", id, time);
-    proc[id].endtime = time;
-    free(n);
+  switch_lost = was_lost;
+  dispatches = was_dispatches;
+  last_dispatched = was_last;
+  if(null != NULL){
+    fclose(null);
   }
-  average_time(proc);
+  free(edited);
+  free(moved);
+}
+
+/* First job marked ready at or after index from, wrapping around */
+int next_ready(fenwick *ready, int from){
+  long long before = fenwick_prefix(ready, from);
+  if(before >= ready->total){
+    before = 0;
+  }
+  return fenwick_find(ready, before);
 }
 
 void round_robin(struct process *proc){
-  int i, time = 0;
+  /*
+   * Takes turns by index: the next job to run is the first ready one
+   * after the last, found in O(log n) in a Fenwick tree of ready flags.
+   */
+  int i, k, count;
+  long long time = 0;
   int flag_count = 0;
   int last_index = 0;
-  queue *q = create_queue();
-  node *n = NULL;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  fenwick *ready = create_fenwick(num_processes);
   
-  for(i = 0; i < NUM_PROCESSES; i++){
+  for(i = 0; i < num_processes; i++){
     proc[i].remainingtime = proc[i].runtime;
   }
 
-  while(flag_count < NUM_PROCESSES){
-    // printf("starting at index %d\n", last_index);
-    for(i = 0; i < NUM_PROCESSES; i++){
-      int j = (last_index + i) % NUM_PROCESSES;
-      if(proc[j].remainingtime > 0 && proc[j].arrivaltime <= time){
-        node *temp = create_node(j, 0);
-        enqueue(q, temp);
-      }
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      fenwick_add(ready, batch[k], 1);
     }
 
-    if(q->size != 0){
-      n = dequeue(q);
-      i = n->id;
+    if(ready->total != 0){
+      i = next_ready(ready, last_index);
       last_index = i + 1;
+      time += dispatch(proc, i);
       if(proc[i].runtime == proc[i].remainingtime){
-        printf("Process %d started at time %d\n", i, time);
+        report_start(i, time);
         proc[i].starttime = time;
       }
-      if(proc[i].remainingtime > 10){
-        proc[i].remainingtime -= 10;
-        time += 10;
+      if(proc[i].remainingtime > quantum){
+        proc[i].remainingtime -= quantum;
+        time += quantum;
       }
       else{
         time += proc[i].remainingtime;
         proc[i].remainingtime = 0;
-        printf("Process %d finished at time %d\n", i, time);
+        report_finish(i, time);
         proc[i].endtime = time;
         flag_count++;
-        free(n);
-        n = NULL;
-      }
-      while(q->size > 0){
-        n = dequeue(q);
-        free(n);
+        fenwick_add(ready, i, -1);
       }
     }
     else{
-      time++;
+      time = stream_peek(a);
     }
 
   }
   average_time(proc);
+  free(batch);
+  free_stream(a);
+  free_fenwick(ready);
 }
 
 void round_robin_priority(struct process *proc){
-  int i, time = 0;
+  /*
+   * Round robin by index within the highest priority that has a ready
+   * job, with a Fenwick tree of ready flags per priority level.
+   */
+  int i, k, p, count;
+  long long time = 0;
   int flag_count = 0;
   int last_index = 0;
-  queue *q = create_queue();
-  node *n = NULL;
+  int levels = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  fenwick **ready;
   
-  for(i = 0; i < NUM_PROCESSES; i++){
+  for(i = 0; i < num_processes; i++){
     proc[i].remainingtime = proc[i].runtime;
+    if(proc[i].priority >= levels){
+      levels = proc[i].priority + 1;
+    }
+  }
+  ready = (fenwick**)malloc(levels * sizeof(fenwick*));
+  for(p = 0; p < levels; p++){
+    ready[p] = create_fenwick(num_processes);
   }
 
-  while(flag_count < NUM_PROCESSES){
-    // printf("starting at index %d\n", last_index);
-    for(i = 0; i < NUM_PROCESSES; i++){
-      int j = (last_index + i) % NUM_PROCESSES;
-      if(proc[j].remainingtime > 0 && proc[j].arrivaltime <= time){
-        node *temp = create_node(j, proc[j].priority);
-        enqueue_priority(q, temp);
-      }
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      fenwick_add(ready[proc[batch[k]].priority], batch[k], 1);
     }
 
-    if(q->size != 0){
-      n = dequeue(q);
-      i = n->id;
+    for(p = levels - 1; p >= 0 && ready[p]->total == 0; p--);
+    if(p >= 0){
+      i = next_ready(ready[p], last_index);
       last_index = i + 1;
+      time += dispatch(proc, i);
       if(proc[i].runtime == proc[i].remainingtime){
-        printf("Process %d started at time %d\n", i, time);
+        report_start(i, time);
         proc[i].starttime = time;
       }
-      if(proc[i].remainingtime > 10){
-        proc[i].remainingtime -= 10;
-        time += 10;
+      if(proc[i].remainingtime > quantum){
+        proc[i].remainingtime -= quantum;
+        time += quantum;
       }
       else{
         time += proc[i].remainingtime;
         proc[i].remainingtime = 0;
-        printf("Process %d finished at time %d\n", i, time);
+        report_finish(i, time);
         proc[i].endtime = time;
         flag_count++;
-        free(n);
-        n = NULL;
+        fenwick_add(ready[p], i, -1);
+      }
+    }
+    else{
+      time = stream_peek(a);
+    }
+
+  }
+  average_time(proc);
+  for(p = 0; p < levels; p++){
+    free_fenwick(ready[p]);
+  }
+  free(ready);
+  free(batch);
+  free_stream(a);
+}
+
+void const_round_robin(struct process *proc){
+  /*
+   * Mirrors ctrr_choose_task in 5b/const_sched.c.  The running job keeps
+   * the CPU while its counter lasts, then the job at the head of the
+   * queue moves to the back with a fresh counter.  Waiting jobs never
+   * hold more counter than the running one, so ctrr_preemptability never
+   * lets an arrival preempt, and a whole quantum runs in one step.
+   * Arrivals join at the back.  Each dispatch is O(1).
+   */
+  int i, k, count;
+  long long time = 0;
+  int flag_count = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  queue *q = create_queue();
+  node *n = NULL;
+
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = proc[i].runtime;
+  }
+
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      enqueue(q, create_node(batch[k], 0));
+    }
+
+    if(q->size == 0){
+      /* Idle until the next arrival */
+      time = stream_peek(a);
+      continue;
+    }
+
+    n = dequeue(q);
+    i = n->id;
+    time += dispatch(proc, i);
+    if(proc[i].runtime == proc[i].remainingtime){
+      report_start(i, time);
+      proc[i].starttime = time;
+    }
+    if(proc[i].remainingtime > quantum){
+      proc[i].remainingtime -= quantum;
+      time += quantum;
+      /* Jobs that arrived during the slice go ahead of it */
+      count = stream_advance(a, time, batch);
+      for(k = 0; k < count; k++){
+        enqueue(q, create_node(batch[k], 0));
+      }
+      enqueue(q, n);
+    }
+    else{
+      time += proc[i].remainingtime;
+      proc[i].remainingtime = 0;
+      report_finish(i, time);
+      proc[i].endtime = time;
+      flag_count++;
+      free(n);
+    }
+  }
+  average_time(proc);
+  free(batch);
+  free_stream(a);
+  free(q);
+}
+
+void stride_scheduling(struct process *proc){
+  /*
+   * Each slice goes to the runnable process with the lowest pass, which
+   * then moves up by its stride, STRIDE1 / tickets, per unit of time run.
+   * CPU time is thus split in proportion to tickets.  Arrivals start at
+   * the pass of the last dispatch so they can't claim time from before
+   * they were there.  Each pick is O(log n) on a heap.
+   */
+  int i, k, count;
+  long long ran, time = 0;
+  int flag_count = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  heap *h = create_heap(num_processes);
+  long long pass, global_pass = 0;
+
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = proc[i].runtime;
+  }
+
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      heap_push(h, batch[k], global_pass);
+    }
+
+    if(h->size == 0){
+      /* Idle until the next arrival */
+      time = stream_peek(a);
+      continue;
+    }
+
+    i = heap_pop(h, &pass);
+    global_pass = pass;
+    time += dispatch(proc, i);
+    if(proc[i].runtime == proc[i].remainingtime){
+      report_start(i, time);
+      proc[i].starttime = time;
+    }
+    ran = proc[i].remainingtime > quantum ? quantum : proc[i].remainingtime;
+    proc[i].remainingtime -= ran;
+    time += ran;
+    if(proc[i].remainingtime > 0){
+      heap_push(h, i, pass + (long long)ran * (STRIDE1 / proc[i].tickets));
+    }
+    else{
+      report_finish(i, time);
+      proc[i].endtime = time;
+      flag_count++;
+    }
+  }
+  average_time(proc);
+  share_by_priority(proc);
+  free(batch);
+  free_stream(a);
+  free_heap(h);
+}
+
+/*
+ * Lottery draws use their own generator so the workload stays the same,
+ * seeded afresh each run so a what-if rerun draws as the run did.
+ */
+#define LOTTERY_SEED 0x9E3779B97F4A7C15ULL
+unsigned long long lottery_seed = LOTTERY_SEED;
+
+unsigned long long lottery_draw(){
+  lottery_seed ^= lottery_seed >> 12;
+  lottery_seed ^= lottery_seed << 25;
+  lottery_seed ^= lottery_seed >> 27;
+  return lottery_seed * 0x2545F4914F6CDD1DULL;
+}
+
+void lottery_scheduling(struct process *proc){
+  /*
+   * Each slice goes to the holder of a ticket drawn at random from the
+   * runnable processes, so shares hold in expectation.  The tickets sit
+   * in a Fenwick tree by process index: joining, leaving and finding the
+   * winner of a draw are all O(log n).
+   */
+  int i, k, count;
+  long long ran, time = 0;
+  int flag_count = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  fenwick *f = create_fenwick(num_processes);
+
+  lottery_seed = LOTTERY_SEED;
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = proc[i].runtime;
+  }
+
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      fenwick_add(f, batch[k], proc[batch[k]].tickets);
+    }
+
+    if(f->total == 0){
+      /* Idle until the next arrival */
+      time = stream_peek(a);
+      continue;
+    }
+
+    i = fenwick_find(f, lottery_draw() % f->total);
+    time += dispatch(proc, i);
+    if(proc[i].runtime == proc[i].remainingtime){
+      report_start(i, time);
+      proc[i].starttime = time;
+    }
+    ran = proc[i].remainingtime > quantum ? quantum : proc[i].remainingtime;
+    proc[i].remainingtime -= ran;
+    time += ran;
+    if(proc[i].remainingtime == 0){
+      fenwick_add(f, i, -proc[i].tickets);
+      report_finish(i, time);
+      proc[i].endtime = time;
+      flag_count++;
+    }
+  }
+  average_time(proc);
+  share_by_priority(proc);
+  free(batch);
+  free_stream(a);
+  free_fenwick(f);
+}
+
+void fair_scheduling(struct process *proc){
+  /*
+   * Like CFS: every runnable job accrues virtual runtime, time run scaled
+   * by TICKETS / tickets, and the job with the least runs next.  Jobs sit
+   * in a red-black tree on vruntime with the leftmost cached, so the pick
+   * is O(1) and putting a job back is O(log n).  A slice is the job's
+   * weighted part of target_latency, with the period stretched so no
+   * slice drops below min_granularity.  Arrivals start at min_vruntime
+   * and so can't claim time from before they were there.
+   */
+  int i, k, count;
+  long long ran, time = 0;
+  int flag_count = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  rbnode *entity = (rbnode*)malloc(num_processes * sizeof(rbnode));
+  rbtree *t = create_rbtree();
+  rbnode *n;
+  long long period, slice, total_weight = 0, min_vruntime = 0;
+
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = proc[i].runtime;
+  }
+
+  while(flag_count < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      i = batch[k];
+      entity[i].id = i;
+      entity[i].key = min_vruntime;
+      rb_insert(t, &entity[i]);
+      total_weight += proc[i].tickets;
+    }
+
+    if(t->size == 0){
+      /* Idle until the next arrival */
+      time = stream_peek(a);
+      continue;
+    }
+
+    n = t->leftmost;
+    rb_erase(t, n);
+    i = n->id;
+    time += dispatch(proc, i);
+    if(proc[i].runtime == proc[i].remainingtime){
+      report_start(i, time);
+      proc[i].starttime = time;
+    }
+
+    period = target_latency;
+    if((long long)(t->size + 1) * min_granularity > period){
+      period = (long long)(t->size + 1) * min_granularity;
+    }
+    slice = period * proc[i].tickets / total_weight;
+    if(slice < min_granularity){
+      slice = min_granularity;
+    }
+    ran = proc[i].remainingtime > slice ? slice : proc[i].remainingtime;
+    proc[i].remainingtime -= ran;
+    time += ran;
+    n->key += (long long)ran * (TICKETS << 10) / proc[i].tickets;
+
+    /* min_vruntime only moves forward, to the least of current and leftmost */
+    if(t->leftmost != NULL && t->leftmost->key < n->key){
+      if(t->leftmost->key > min_vruntime){
+        min_vruntime = t->leftmost->key;
+      }
+    }
+    else if(n->key > min_vruntime){
+      min_vruntime = n->key;
+    }
+
+    if(proc[i].remainingtime > 0){
+      rb_insert(t, n);
+    }
+    else{
+      total_weight -= proc[i].tickets;
+      report_finish(i, time);
+      proc[i].endtime = time;
+      flag_count++;
+    }
+  }
+  average_time(proc);
+  share_by_priority(proc);
+  free(batch);
+  free_stream(a);
+  free(entity);
+  free(t);
+}
+
+/* Ready queue key of jobs without a deadline, or turned away: after all */
+#define BEST_EFFORT (1LL << 62)
+
+void edf_run(struct process *proc, int admit){
+  /*
+   * The job with the earliest deadline runs, and an arrival with an
+   * earlier one preempts it.  Jobs without a deadline run first come
+   * first served when no deadline job is ready.  Ready jobs sit in a heap
+   * keyed by deadline, so each pick is O(log n).
+   *
+   * With admit set, a deadline job is only taken on if the densities,
+   * runtime / (deadline - arrival), of the admitted jobs whose windows
+   * are open still sum to at most 1.  Below that bound EDF meets every
+   * admitted deadline.  A job that doesn't fit runs as best effort.
+   */
+  int i, j, k, count;
+  long long ran, next, time = 0;
+  int flag_count = 0, admitted = 0, rejected = 0, missed = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  heap *ready = create_heap(num_processes);
+  heap *windows = create_heap(num_processes);
+  double density = 0, d;
+  long long key;
+
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = proc[i].runtime;
+  }
+
+  while(flag_count < num_processes){
+    /* Admitted jobs give their density back when their window closes */
+    while(windows->size > 0 && windows->key[0] <= time){
+      j = heap_pop(windows, &key);
+      density -= (double)proc[j].runtime / (proc[j].deadline - proc[j].arrivaltime);
+    }
+
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      j = batch[k];
+      key = BEST_EFFORT + proc[j].arrivaltime;
+      if(proc[j].deadline > 0){
+        d = (double)proc[j].runtime / (proc[j].deadline - proc[j].arrivaltime);
+        if(!admit){
+          key = proc[j].deadline;
+        }
+        else if(density + d <= 1.0 + 1e-9){
+          key = proc[j].deadline;
+          density += d;
+          heap_push(windows, j, proc[j].deadline);
+          admitted++;
+        }
+        else{
+          rejected++;
+        }
+      }
+      heap_push(ready, j, key);
+    }
+
+    if(ready->size == 0){
+      /* Idle until the next arrival */
+      time = stream_peek(a);
+      continue;
+    }
+
+    i = heap_pop(ready, &key);
+    time += dispatch(proc, i);
+    if(proc[i].runtime == proc[i].remainingtime){
+      report_start(i, time);
+      proc[i].starttime = time;
+    }
+
+    /* Run to completion or to the next arrival, which may preempt */
+    ran = proc[i].remainingtime;
+    next = stream_peek(a);
+    if(next >= 0 && next - time < ran){
+      ran = next - time;
+    }
+    if(ran < 0){
+      /* Something arrived while we switched, look again */
+      ran = 0;
+    }
+    proc[i].remainingtime -= ran;
+    time += ran;
+    if(proc[i].remainingtime > 0){
+      heap_push(ready, i, key);
+    }
+    else{
+      report_finish(i, time);
+      proc[i].endtime = time;
+      flag_count++;
+      if(admit && key < BEST_EFFORT && time > proc[i].deadline){
+        missed++;
+      }
+    }
+  }
+  average_time(proc);
+  if(admit){
+    printf("Admitted %d deadline jobs, turned away %d, admitted jobs missed %d\n",
+           admitted, rejected, missed);
+  }
+  free(batch);
+  free_stream(a);
+  free_heap(ready);
+  free_heap(windows);
+}
+
+void earliest_deadline_first(struct process *proc){
+  edf_run(proc, 0);
+}
+
+void earliest_deadline_admission(struct process *proc){
+  edf_run(proc, 1);
+}
+
+/*
+ * Multi-threaded jobs on cpus CPUs.  Each of a job's threads needs its
+ * runtime on a CPU, and the job finishes with its last thread.  Both
+ * policies end with how the machine was used: busy time, time lost to
+ * fragmentation, CPUs idle while threads waited, and the rest, idle for
+ * want of work.  The dispatch cost model is a single CPU's and isn't
+ * charged here.
+ */
+void machine_use(struct process *proc, long long busy, long long fragmented){
+  long long makespan = 0;
+  double capacity;
+  int i;
+  for(i = 0; i < num_processes; i++){
+    if(proc[i].endtime > makespan){
+      makespan = proc[i].endtime;
+    }
+  }
+  capacity = (double)cpus * (makespan > 0 ? makespan : 1);
+  printf("CPUs busy %.1f%% of %d x %lld seconds, %.1f%% lost to fragmentation, "
+         "%.1f%% idle without work\n", 100 * busy / capacity, cpus, makespan,
+         100 * fragmented / capacity, 100 - 100 * (busy + fragmented) / capacity);
+}
+
+/* Columns a job takes in a gang, a job wider than the machine folds onto it */
+int gang_width(struct process *p){
+  return p->threads < cpus ? p->threads : cpus;
+}
+
+long long gang_time(struct process *p){
+  long long work = p->runtime * p->threads;
+  return p->threads <= cpus ? p->runtime : (work + cpus - 1) / cpus;
+}
+
+/*
+ * Ousterhout's matrix: a row is a time slot with a column a CPU, and an
+ * arrival takes as many columns as it has threads in the first row with
+ * room.  Rows take turns a quantum each and all the jobs of a row run
+ * every thread at once.  Columns no job in the row holds, and columns of
+ * a job whose slice ended early, idle until the slot ends, fragmentation
+ * whenever another row had work waiting.  A tree of each row's free
+ * columns finds the first fit in O(log rows).
+ */
+void gang_scheduling(struct process *proc){
+  int i, k, count, row, rows = 0, done = 0, width, *link;
+  long long time = 0, ran, slot, used, busy = 0, fragmented = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  int *first = (int*)malloc(num_processes * sizeof(int));    /* Row's first job */
+  int *next = (int*)malloc(num_processes * sizeof(int));     /* Next in the row */
+  char *turning = (char*)calloc(num_processes, sizeof(char)); /* Row has a turn queued */
+  maxtree *room = create_maxtree(num_processes);
+  queue *turns = create_queue();
+  node *n;
+
+  for(i = 0; i < num_processes; i++){
+    proc[i].remainingtime = gang_time(&proc[i]);
+  }
+
+  while(done < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      i = batch[k];
+      proc[i].flag = 1;
+      width = gang_width(&proc[i]);
+      row = maxtree_first(room, width);
+      if(row < 0){
+        row = rows++;
+        first[row] = -1;
+        maxtree_set(room, row, cpus);
+      }
+      maxtree_set(room, row, maxtree_get(room, row) - width);
+      next[i] = first[row];
+      first[row] = i;
+      if(!turning[row]){
+        enqueue(turns, create_node(row, 0));
+        turning[row] = 1;
+      }
+    }
+    if(turns->size == 0){
+      time = stream_peek(a);
+      continue;
+    }
+
+    n = dequeue(turns);
+    row = n->id;
+    free(n);
+    slot = 0;
+    used = 0;
+    for(i = first[row]; i >= 0; i = next[i]){
+      if(proc[i].remainingtime == gang_time(&proc[i])){
+        report_start(i, time);
+        proc[i].starttime = time;
+      }
+      ran = proc[i].remainingtime > quantum ? quantum : proc[i].remainingtime;
+      proc[i].remainingtime -= ran;
+      used += ran * gang_width(&proc[i]);
+      if(ran > slot){
+        slot = ran;
+      }
+      if(proc[i].remainingtime == 0){
+        report_finish(i, time + ran);
+        proc[i].endtime = time + ran;
+        done++;
+      }
+    }
+    busy += used;
+    if(turns->size > 0){
+      fragmented += cpus * slot - used;
+    }
+    time += slot;
+
+    /* Finished jobs give their columns back */
+    for(link = &first[row]; *link >= 0; ){
+      i = *link;
+      if(proc[i].remainingtime == 0){
+        maxtree_set(room, row, maxtree_get(room, row) + gang_width(&proc[i]));
+        *link = next[i];
       }
-      while(q->size > 0){
-        n = dequeue(q);
-        free(n);
+      else{
+        link = &next[i];
       }
     }
+    if(first[row] >= 0){
+      enqueue(turns, create_node(row, 0));
+    }
     else{
-      time++;
+      turning[row] = 0;
+    }
+  }
+  average_time(proc);
+  machine_use(proc, busy, fragmented);
+  free(batch);
+  free(first);
+  free(next);
+  free(turning);
+  free_maxtree(room);
+  free_stream(a);
+  free(turns);
+}
+
+/*
+ * The same machine with every thread scheduled on its own, the baseline
+ * gang scheduling is measured against.  One round robin queue holds the
+ * threads and a CPU that comes free takes the next for a quantum, so no
+ * CPU idles while a thread waits, though a job's threads seldom run
+ * together.  Running threads sit in a heap by the end of their slice.
+ */
+void thread_scheduling(struct process *proc){
+  int i, k, t, count, done = 0, idle = cpus;
+  long total = 0;
+  long long time = 0, next, end, busy = 0;
+  stream *a = arrivals(proc);
+  int *batch = (int*)malloc(num_processes * sizeof(int));
+  long *base = (long*)malloc(num_processes * sizeof(long));   /* Job's first thread */
+  int *alive = (int*)malloc(num_processes * sizeof(int));     /* Threads not done */
+  int *job;
+  long long *left, *slice;
+  queue *ready = create_queue();
+  heap *running = create_heap(cpus);
+  node *n;
+
+  for(i = 0; i < num_processes; i++){
+    base[i] = total;
+    total += proc[i].threads;
+    alive[i] = proc[i].threads;
+    proc[i].remainingtime = proc[i].runtime * proc[i].threads;
+    proc[i].flag = 0;       /* Set once the job's first thread runs */
+  }
+  job = (int*)malloc(total * sizeof(int));
+  left = (long long*)malloc(total * sizeof(long long));
+  slice = (long long*)malloc(total * sizeof(long long));
+  for(i = 0; i < num_processes; i++){
+    for(t = 0; t < proc[i].threads; t++){
+      job[base[i] + t] = i;
+      left[base[i] + t] = proc[i].runtime;
+    }
+  }
+
+  while(done < num_processes){
+    count = stream_advance(a, time, batch);
+    for(k = 0; k < count; k++){
+      i = batch[k];
+      for(t = 0; t < proc[i].threads; t++){
+        enqueue(ready, create_node(base[i] + t, 0));
+      }
+    }
+    while(idle > 0 && ready->size > 0){
+      n = dequeue(ready);
+      t = n->id;
+      free(n);
+      i = job[t];
+      if(!proc[i].flag){
+        report_start(i, time);
+        proc[i].starttime = time;
+        proc[i].flag = 1;
+      }
+      slice[t] = left[t] > quantum ? quantum : left[t];
+      heap_push(running, t, time + slice[t]);
+      busy += slice[t];
+      idle--;
+    }
+    if(running->size == 0){
+      time = stream_peek(a);
+      continue;
     }
 
+    /* On to the next arrival or the next slice to end */
+    next = stream_peek(a);
+    if(next >= 0 && next < running->key[0]){
+      time = next;
+      continue;
+    }
+    time = running->key[0];
+    while(running->size > 0 && running->key[0] == time){
+      t = heap_pop(running, &end);
+      i = job[t];
+      idle++;
+      left[t] -= slice[t];
+      proc[i].remainingtime -= slice[t];
+      if(left[t] > 0){
+        enqueue(ready, create_node(t, 0));
+      }
+      else if(--alive[i] == 0){
+        report_finish(i, time);
+        proc[i].endtime = time;
+        done++;
+      }
+    }
   }
   average_time(proc);
-}
\ No newline at end of file
+  machine_use(proc, busy, 0);
+  free(batch);
+  free(base);
+  free(alive);
+  free(job);
+  free(left);
+  free(slice);
+  free_heap(running);
+  free_stream(a);
+  free(ready);
+}
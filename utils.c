@@ -1,4 +1,19 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <utime.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VEC_X86
+#endif
 
 typedef struct node{
   int id;
@@ -8,6 +23,7 @@ typedef struct node{
 
 typedef struct queue{
   node *head;
+  node *tail;
   int size;
 }queue;
 
@@ -23,12 +39,16 @@ queue *create_queue(){
   queue *temp = (queue*)malloc(sizeof(queue));
   temp->size = 0;
   temp->head = NULL;
+  temp->tail = NULL;
   return temp;
 }
 
 node *dequeue(queue *q){
   node *temp = q->head;
   q->head = temp->next;
+  if(q->head == NULL){
+    q->tail = NULL;
+  }
   q->size--;
   temp->next = NULL;
   return temp;
@@ -39,18 +59,16 @@ void enqueue(queue *q, node *n){
     q->head = n;
   }
   else{
-    node *a = q->head;
-    while(a->next != NULL){
-      a = a->next;
-    }
-    a->next = n;
+    q->tail->next = n;
   }
+  q->tail = n;
   q->size++;
 }
 
 void enqueue_time(queue *q, node *n){
   if(q->size == 0){
     q->head = n;
+    q->tail = n;
   }
   else{
     node *a = NULL;
@@ -68,6 +86,7 @@ void enqueue_time(queue *q, node *n){
       }
       else if(b->next == NULL){
         b->next = n;
+        q->tail = n;
         finished = 1;
       }
       a = b;
@@ -81,6 +100,7 @@ void enqueue_runtime(queue *q, node *n){
   // printf("%d:\t", n->id);
   if(q->size == 0){
     q->head = n;
+    q->tail = n;
     // printf("Starting queue\n");
   }
   else{
@@ -101,6 +121,7 @@ void enqueue_runtime(queue *q, node *n){
       else if(b->next == NULL){
         // printf("Putting to end of queue\n");
         b->next = n;
+        q->tail = n;
         finished = 1;
       }
       a = b;
@@ -114,6 +135,7 @@ void enqueue_priority(queue *q, node *n){
   // printf("%d:\t", n->id);
   if(q->size == 0){
     q->head = n;
+    q->tail = n;
     // printf("Starting queue\n");
   }
   else{
@@ -134,6 +156,7 @@ void enqueue_priority(queue *q, node *n){
       else if(b->next == NULL){
         // printf("Putting to end of queue\n");
         b->next = n;
+        q->tail = n;
         finished = 1;
       }
       a = b;
@@ -160,4 +183,1504 @@ void print_queue(queue *queue){
     printf("Empty\n");
   }
   
-}
\ No newline at end of file
+}
+
+/* Binary min heap of ids keyed by a 64 bit value, ties go to the lower id */
+typedef struct heap{
+  int *id;
+  long long *key;
+  int size;
+}heap;
+
+heap *create_heap(int capacity){
+  heap *h = (heap*)malloc(sizeof(heap));
+  h->id = (int*)malloc(capacity * sizeof(int));
+  h->key = (long long*)malloc(capacity * sizeof(long long));
+  h->size = 0;
+  return h;
+}
+
+void free_heap(heap *h){
+  free(h->id);
+  free(h->key);
+  free(h);
+}
+
+int heap_less(heap *h, int a, int b){
+  if(h->key[a] != h->key[b]){
+    return h->key[a] < h->key[b];
+  }
+  return h->id[a] < h->id[b];
+}
+
+void heap_swap(heap *h, int a, int b){
+  int id = h->id[a];
+  long long key = h->key[a];
+  h->id[a] = h->id[b];
+  h->key[a] = h->key[b];
+  h->id[b] = id;
+  h->key[b] = key;
+}
+
+void heap_push(heap *h, int id, long long key){
+  int i = h->size++;
+  h->id[i] = id;
+  h->key[i] = key;
+  while(i > 0 && heap_less(h, i, (i - 1) / 2)){
+    heap_swap(h, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/* Removes the smallest entry, returns its id and key */
+int heap_pop(heap *h, long long *key){
+  int i = 0, child;
+  int id = h->id[0];
+  *key = h->key[0];
+  h->size--;
+  h->id[0] = h->id[h->size];
+  h->key[0] = h->key[h->size];
+  while((child = 2 * i + 1) < h->size){
+    if(child + 1 < h->size && heap_less(h, child + 1, child)){
+      child++;
+    }
+    if(!heap_less(h, child, i)){
+      break;
+    }
+    heap_swap(h, i, child);
+    i = child;
+  }
+  return id;
+}
+
+/* Fenwick tree of counts in slots 0..size-1, for weighted random picks */
+typedef struct fenwick{
+  long long *tree;
+  long long total;
+  int size;
+}fenwick;
+
+fenwick *create_fenwick(int size){
+  fenwick *f = (fenwick*)malloc(sizeof(fenwick));
+  f->tree = (long long*)calloc(size + 1, sizeof(long long));
+  f->total = 0;
+  f->size = size;
+  return f;
+}
+
+void free_fenwick(fenwick *f){
+  free(f->tree);
+  free(f);
+}
+
+void fenwick_add(fenwick *f, int slot, long long v){
+  int i;
+  f->total += v;
+  for(i = slot + 1; i <= f->size; i += i & -i){
+    f->tree[i] += v;
+  }
+}
+
+/* Slot holding count number r, counting from 0, for 0 <= r < total */
+int fenwick_find(fenwick *f, long long r){
+  int i = 0, step = 1;
+  while(step * 2 <= f->size){
+    step *= 2;
+  }
+  for(; step > 0; step /= 2){
+    if(i + step <= f->size && f->tree[i + step] <= r){
+      i += step;
+      r -= f->tree[i];
+    }
+  }
+  return i;
+}
+
+/* Segment tree of values in slots 0..size-1, for the first holding enough */
+typedef struct maxtree{
+  int *max;                 /* max[1] is the root, leaves from max[leaves] */
+  int leaves;
+}maxtree;
+
+maxtree *create_maxtree(int size){
+  maxtree *t = (maxtree*)malloc(sizeof(maxtree));
+  t->leaves = 1;
+  while(t->leaves < size){
+    t->leaves *= 2;
+  }
+  t->max = (int*)calloc(2 * t->leaves, sizeof(int));
+  return t;
+}
+
+void free_maxtree(maxtree *t){
+  free(t->max);
+  free(t);
+}
+
+void maxtree_set(maxtree *t, int slot, int v){
+  int i = t->leaves + slot;
+  t->max[i] = v;
+  for(i /= 2; i > 0; i /= 2){
+    t->max[i] = t->max[2 * i] > t->max[2 * i + 1] ? t->max[2 * i] : t->max[2 * i + 1];
+  }
+}
+
+int maxtree_get(maxtree *t, int slot){
+  return t->max[t->leaves + slot];
+}
+
+/* Lowest slot holding at least v, -1 if none does */
+int maxtree_first(maxtree *t, int v){
+  int i = 1;
+  if(t->max[1] < v){
+    return -1;
+  }
+  while(i < t->leaves){
+    i = t->max[2 * i] >= v ? 2 * i : 2 * i + 1;
+  }
+  return i - t->leaves;
+}
+
+/* Lowest slot from on holding at least v, -1 if none does */
+int maxtree_next(maxtree *t, int from, int v){
+  int i = t->leaves + from;
+  if(from >= t->leaves){
+    return -1;
+  }
+  /* Up while nothing to the right of the path holds one */
+  while(t->max[i] < v){
+    while(i % 2 == 1){
+      i /= 2;
+      if(i == 0){
+        return -1;
+      }
+    }
+    i++;
+  }
+  while(i < t->leaves){
+    i = t->max[2 * i] >= v ? 2 * i : 2 * i + 1;
+  }
+  return i - t->leaves;
+}
+
+/* Red-black tree ordered by key, equal keys go right, leftmost cached */
+typedef struct rbnode{
+  int id;
+  long long key;
+  int red;
+  struct rbnode *left, *right, *parent;
+}rbnode;
+
+typedef struct rbtree{
+  rbnode *root;
+  rbnode *leftmost;
+  int size;
+}rbtree;
+
+rbtree *create_rbtree(){
+  rbtree *t = (rbtree*)malloc(sizeof(rbtree));
+  t->root = NULL;
+  t->leftmost = NULL;
+  t->size = 0;
+  return t;
+}
+
+void rb_rotate_left(rbtree *t, rbnode *x){
+  rbnode *y = x->right;
+  x->right = y->left;
+  if(y->left != NULL){
+    y->left->parent = x;
+  }
+  y->parent = x->parent;
+  if(x->parent == NULL){
+    t->root = y;
+  }
+  else if(x == x->parent->left){
+    x->parent->left = y;
+  }
+  else{
+    x->parent->right = y;
+  }
+  y->left = x;
+  x->parent = y;
+}
+
+void rb_rotate_right(rbtree *t, rbnode *x){
+  rbnode *y = x->left;
+  x->left = y->right;
+  if(y->right != NULL){
+    y->right->parent = x;
+  }
+  y->parent = x->parent;
+  if(x->parent == NULL){
+    t->root = y;
+  }
+  else if(x == x->parent->right){
+    x->parent->right = y;
+  }
+  else{
+    x->parent->left = y;
+  }
+  y->right = x;
+  x->parent = y;
+}
+
+rbnode *rb_next(rbnode *n){
+  if(n->right != NULL){
+    n = n->right;
+    while(n->left != NULL){
+      n = n->left;
+    }
+    return n;
+  }
+  while(n->parent != NULL && n == n->parent->right){
+    n = n->parent;
+  }
+  return n->parent;
+}
+
+void rb_insert(rbtree *t, rbnode *n){
+  rbnode *p = NULL, *g, *u;
+  rbnode **link = &t->root;
+  int leftmost = 1;
+
+  while(*link != NULL){
+    p = *link;
+    if(n->key < p->key){
+      link = &p->left;
+    }
+    else{
+      link = &p->right;
+      leftmost = 0;
+    }
+  }
+  n->parent = p;
+  n->left = NULL;
+  n->right = NULL;
+  n->red = 1;
+  *link = n;
+  if(leftmost){
+    t->leftmost = n;
+  }
+  t->size++;
+
+  while((p = n->parent) != NULL && p->red){
+    g = p->parent;
+    if(p == g->left){
+      u = g->right;
+      if(u != NULL && u->red){
+        p->red = 0;
+        u->red = 0;
+        g->red = 1;
+        n = g;
+      }
+      else{
+        if(n == p->right){
+          n = p;
+          rb_rotate_left(t, n);
+          p = n->parent;
+        }
+        p->red = 0;
+        g->red = 1;
+        rb_rotate_right(t, g);
+      }
+    }
+    else{
+      u = g->left;
+      if(u != NULL && u->red){
+        p->red = 0;
+        u->red = 0;
+        g->red = 1;
+        n = g;
+      }
+      else{
+        if(n == p->left){
+          n = p;
+          rb_rotate_right(t, n);
+          p = n->parent;
+        }
+        p->red = 0;
+        g->red = 1;
+        rb_rotate_left(t, g);
+      }
+    }
+  }
+  t->root->red = 0;
+}
+
+void rb_transplant(rbtree *t, rbnode *u, rbnode *v){
+  if(u->parent == NULL){
+    t->root = v;
+  }
+  else if(u == u->parent->left){
+    u->parent->left = v;
+  }
+  else{
+    u->parent->right = v;
+  }
+  if(v != NULL){
+    v->parent = u->parent;
+  }
+}
+
+void rb_erase(rbtree *t, rbnode *z){
+  rbnode *y = z, *x, *xp, *w;
+  int y_red = y->red;
+
+  if(t->leftmost == z){
+    t->leftmost = rb_next(z);
+  }
+
+  if(z->left == NULL){
+    x = z->right;
+    xp = z->parent;
+    rb_transplant(t, z, z->right);
+  }
+  else if(z->right == NULL){
+    x = z->left;
+    xp = z->parent;
+    rb_transplant(t, z, z->left);
+  }
+  else{
+    y = z->right;
+    while(y->left != NULL){
+      y = y->left;
+    }
+    y_red = y->red;
+    x = y->right;
+    if(y->parent == z){
+      xp = y;
+    }
+    else{
+      xp = y->parent;
+      rb_transplant(t, y, y->right);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    rb_transplant(t, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->red = z->red;
+  }
+  t->size--;
+  if(y_red){
+    return;
+  }
+
+  /* A black node left, push the missing black back up */
+  while(x != t->root && (x == NULL || !x->red)){
+    if(x == xp->left){
+      w = xp->right;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rb_rotate_left(t, xp);
+        w = xp->right;
+      }
+      if((w->left == NULL || !w->left->red) && (w->right == NULL || !w->right->red)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      }
+      else{
+        if(w->right == NULL || !w->right->red){
+          w->left->red = 0;
+          w->red = 1;
+          rb_rotate_right(t, w);
+          w = xp->right;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        if(w->right != NULL){
+          w->right->red = 0;
+        }
+        rb_rotate_left(t, xp);
+        x = t->root;
+      }
+    }
+    else{
+      w = xp->left;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rb_rotate_right(t, xp);
+        w = xp->left;
+      }
+      if((w->left == NULL || !w->left->red) && (w->right == NULL || !w->right->red)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      }
+      else{
+        if(w->left == NULL || !w->left->red){
+          w->right->red = 0;
+          w->red = 1;
+          rb_rotate_left(t, w);
+          w = xp->left;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        if(w->left != NULL){
+          w->left->red = 0;
+        }
+        rb_rotate_right(t, xp);
+        x = t->root;
+      }
+    }
+  }
+  if(x != NULL){
+    x->red = 0;
+  }
+}
+
+/* Sum of the counts in slots before slot */
+long long fenwick_prefix(fenwick *f, int slot){
+  long long sum = 0;
+  int i;
+  for(i = slot; i > 0; i -= i & -i){
+    sum += f->tree[i];
+  }
+  return sum;
+}
+
+#define MAX_WORKERS 64
+
+/* Threads to split n items over, one below serial items, else one a CPU */
+int worker_count(long n, long serial){
+  int threads = n < serial ? 1 : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if(threads < 1){
+    threads = 1;
+  }
+  if(threads > MAX_WORKERS){
+    threads = MAX_WORKERS;
+  }
+  return threads;
+}
+
+/*
+ * Parallel LSD radix sort of (key, id) items on key, 8 bits a pass, with
+ * no pass for the high digits that every key has zero.  Every pass is
+ * stable, so items with equal keys keep the order they came in.  Each
+ * thread counts the digits of its own slice, then writes its slice out
+ * behind the slices before it, so the work is a few streaming passes
+ * over memory and no comparisons.
+ */
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_SERIAL (1 << 16)   /* Below this many items one thread does it */
+
+typedef struct radix_item{
+  unsigned long long key;
+  int id;
+}radix_item;
+
+typedef struct radix_job{
+  radix_item *src, *dst;
+  long from, to;
+  int shift;
+  long count[RADIX_BUCKETS];     /* Digit counts, then where each one goes */
+}radix_job;
+
+void *radix_count(void *arg){
+  radix_job *job = (radix_job*)arg;
+  long i;
+  memset(job->count, 0, sizeof(job->count));
+  for(i = job->from; i < job->to; i++){
+    job->count[(job->src[i].key >> job->shift) & (RADIX_BUCKETS - 1)]++;
+  }
+  return NULL;
+}
+
+void *radix_scatter(void *arg){
+  radix_job *job = (radix_job*)arg;
+  long i;
+  for(i = job->from; i < job->to; i++){
+    job->dst[job->count[(job->src[i].key >> job->shift) & (RADIX_BUCKETS - 1)]++] = job->src[i];
+  }
+  return NULL;
+}
+
+void radix_run(radix_job *jobs, int threads, void *(*work)(void*)){
+  pthread_t tid[MAX_WORKERS];
+  int t;
+  if(threads == 1){
+    work(&jobs[0]);
+    return;
+  }
+  for(t = 0; t < threads; t++){
+    pthread_create(&tid[t], NULL, work, &jobs[t]);
+  }
+  for(t = 0; t < threads; t++){
+    pthread_join(tid[t], NULL);
+  }
+}
+
+/* Sorts item[0..n-1], tmp must hold n more */
+void radix_sort(radix_item *item, radix_item *tmp, long n){
+  radix_job *jobs;
+  radix_item *src = item, *dst = tmp, *swap;
+  unsigned long long top = 0;
+  long i, offset;
+  int t, d, shift, threads;
+
+  threads = worker_count(n, RADIX_SERIAL);
+  jobs = (radix_job*)malloc(threads * sizeof(radix_job));
+
+  for(i = 0; i < n; i++){
+    top |= item[i].key;
+  }
+
+  for(shift = 0; top != 0; shift += RADIX_BITS, top >>= RADIX_BITS){
+    for(t = 0; t < threads; t++){
+      jobs[t].src = src;
+      jobs[t].dst = dst;
+      jobs[t].from = n * t / threads;
+      jobs[t].to = n * (t + 1) / threads;
+      jobs[t].shift = shift;
+    }
+    radix_run(jobs, threads, radix_count);
+
+    /* Digit by digit, and within a digit thread by thread, keeps it stable */
+    offset = 0;
+    for(d = 0; d < RADIX_BUCKETS; d++){
+      for(t = 0; t < threads; t++){
+        long c = jobs[t].count[d];
+        jobs[t].count[d] = offset;
+        offset += c;
+      }
+    }
+    radix_run(jobs, threads, radix_scatter);
+
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if(src != item){
+    memcpy(item, src, n * sizeof(radix_item));
+  }
+  free(jobs);
+}
+
+/* Ids in the order they fall due, keyed by time, walked by cursor */
+typedef struct stream{
+  radix_item *item;
+  long next;
+  long size;
+}stream;
+
+void free_stream(stream *s){
+  free(s->item);
+  free(s);
+}
+
+/* Time the next id falls due, or -1 once all are handed out */
+long long stream_peek(stream *s){
+  if(s->next >= s->size){
+    return -1;
+  }
+  return (long long)s->item[s->next].key;
+}
+
+/* Hands out every id due by time into out, in order, returns how many */
+int stream_advance(stream *s, long long time, int *out){
+  int count = 0;
+  while(s->next < s->size && (long long)s->item[s->next].key <= time){
+    out[count++] = s->item[s->next].id;
+    s->next++;
+  }
+  return count;
+}
+
+/*
+ * A 128 bit total, for sums of 64 bit times that could pass 2^63.  Only
+ * adding and a divide by a count below 2^31 are needed.
+ */
+typedef struct wide{
+  long long hi;
+  unsigned long long lo;
+}wide;
+
+void wide_add(wide *w, long long v){
+  unsigned long long lo = w->lo + (unsigned long long)v;
+  w->hi += (v < 0 ? -1 : 0) + (lo < w->lo ? 1 : 0);
+  w->lo = lo;
+}
+
+/* Quotient rounded toward zero, which must fit in 64 bits, 0 < n < 2^31 */
+long long wide_div(wide w, long long n){
+  unsigned long long limb[4], q = 0, rem = 0, cur;
+  int k, negative = w.hi < 0;
+  if(negative){
+    w.lo = ~w.lo + 1;
+    w.hi = ~w.hi + (w.lo == 0 ? 1 : 0);
+  }
+  limb[0] = (unsigned long long)w.hi >> 32;
+  limb[1] = (unsigned long long)w.hi & 0xFFFFFFFF;
+  limb[2] = w.lo >> 32;
+  limb[3] = w.lo & 0xFFFFFFFF;
+  for(k = 0; k < 4; k++){
+    cur = rem << 32 | limb[k];
+    q = q << 32 | cur / n;
+    rem = cur % n;
+  }
+  return negative ? -(long long)q : (long long)q;
+}
+
+/* Nearest double, for ratios of sums */
+double wide_double(wide w){
+  return (double)w.hi * 18446744073709551616.0 + (double)w.lo;
+}
+
+/*
+ * Vector kernels over columns of 64 bit times.  Each comes scalar and, on
+ * x86, in SSE4.2 and AVX2 builds picked by target attribute, so the file
+ * needs no special flags.  The first call finds the widest one the CPU
+ * runs.  Every version gives the same answer as the scalar one.  AVX2
+ * has no 64 bit min, so the hot first min scan also has an AVX-512 one.
+ */
+#define VEC_SCALAR 0
+#define VEC_SSE 1
+#define VEC_AVX2 2
+#define VEC_AVX512 3
+#define VEC_BLOCK 4096    /* Values summed in 64 bit lanes before they're carried */
+
+int vec_level = -1;   /* Kernels in use, -1 until picked, set it to force one */
+
+int vec_pick(){
+  if(vec_level < 0){
+    vec_level = VEC_SCALAR;
+#ifdef VEC_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")){
+      vec_level = VEC_AVX512;
+    }
+    else if(__builtin_cpu_supports("avx2")){
+      vec_level = VEC_AVX2;
+    }
+    else if(__builtin_cpu_supports("sse4.2")){
+      vec_level = VEC_SSE;
+    }
+#endif
+  }
+  return vec_level;
+}
+
+/* Index of the first smallest of v[0..n-1], -1 if none is below LLONG_MAX */
+long vec_first_min_scalar(const long long *v, long n){
+  long i, best = -1;
+  long long min = LLONG_MAX;
+  for(i = 0; i < n; i++){
+    if(v[i] < min){
+      min = v[i];
+      best = i;
+    }
+  }
+  return best;
+}
+
+/*
+ * Turnaround style reductions, the sum, least and most of hi[k] - lo[k],
+ * taking every stride'th value, so a field of an array of structs works
+ * too.  The sum is 128 bits; the vector lanes hold VEC_BLOCK values'
+ * worth before carrying, safe while each difference is below 2^50.
+ */
+void vec_span_scalar(const long long *hi, const long long *lo, long n, long stride,
+                     wide *sum, long long *min, long long *max){
+  long i;
+  long long d;
+  sum->hi = 0;
+  sum->lo = 0;
+  *min = LLONG_MAX;
+  *max = LLONG_MIN;
+  for(i = 0; i < n; i++){
+    d = hi[i * stride] - lo[i * stride];
+    wide_add(sum, d);
+    if(d < *min){
+      *min = d;
+    }
+    if(d > *max){
+      *max = d;
+    }
+  }
+}
+
+#ifdef VEC_X86
+/* Minimum first, then the first lane holding it */
+__attribute__((target("sse4.2")))
+long vec_first_min_sse(const long long *v, long n){
+  __m128i m = _mm_set1_epi64x(LLONG_MAX), x, want;
+  long long lane[2], min;
+  int hit;
+  long i;
+  for(i = 0; i + 2 <= n; i += 2){
+    x = _mm_loadu_si128((const __m128i*)(v + i));
+    m = _mm_blendv_epi8(m, x, _mm_cmpgt_epi64(m, x));
+  }
+  _mm_storeu_si128((__m128i*)lane, m);
+  min = lane[0] < lane[1] ? lane[0] : lane[1];
+  for(; i < n; i++){
+    if(v[i] < min){
+      min = v[i];
+    }
+  }
+  if(min == LLONG_MAX){
+    return -1;
+  }
+  want = _mm_set1_epi64x(min);
+  for(i = 0; i + 2 <= n; i += 2){
+    hit = _mm_movemask_pd(_mm_castsi128_pd(
+            _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)(v + i)), want)));
+    if(hit){
+      return i + __builtin_ctz(hit);
+    }
+  }
+  for(; i < n; i++){
+    if(v[i] == min){
+      return i;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx2")))
+long vec_first_min_avx2(const long long *v, long n){
+  __m256i m = _mm256_set1_epi64x(LLONG_MAX), x, want;
+  long long lane[4], min;
+  int hit;
+  long i;
+  for(i = 0; i + 4 <= n; i += 4){
+    x = _mm256_loadu_si256((const __m256i*)(v + i));
+    m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+  }
+  _mm256_storeu_si256((__m256i*)lane, m);
+  min = LLONG_MAX;
+  for(hit = 0; hit < 4; hit++){
+    if(lane[hit] < min){
+      min = lane[hit];
+    }
+  }
+  for(; i < n; i++){
+    if(v[i] < min){
+      min = v[i];
+    }
+  }
+  if(min == LLONG_MAX){
+    return -1;
+  }
+  want = _mm256_set1_epi64x(min);
+  for(i = 0; i + 4 <= n; i += 4){
+    hit = _mm256_movemask_pd(_mm256_castsi256_pd(
+            _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(v + i)), want)));
+    if(hit){
+      return i + __builtin_ctz(hit);
+    }
+  }
+  for(; i < n; i++){
+    if(v[i] == min){
+      return i;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx512f")))
+long vec_first_min_avx512(const long long *v, long n){
+  __m512i m = _mm512_set1_epi64(LLONG_MAX), want;
+  long long min;
+  __mmask8 hit;
+  long i;
+  for(i = 0; i + 8 <= n; i += 8){
+    m = _mm512_min_epi64(m, _mm512_loadu_si512((const void*)(v + i)));
+  }
+  min = _mm512_reduce_min_epi64(m);
+  for(; i < n; i++){
+    if(v[i] < min){
+      min = v[i];
+    }
+  }
+  if(min == LLONG_MAX){
+    return -1;
+  }
+  want = _mm512_set1_epi64(min);
+  for(i = 0; i + 8 <= n; i += 8){
+    hit = _mm512_cmpeq_epi64_mask(_mm512_loadu_si512((const void*)(v + i)), want);
+    if(hit){
+      return i + __builtin_ctz(hit);
+    }
+  }
+  for(; i < n; i++){
+    if(v[i] == min){
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* SSE has no gather, so a strided column is loaded lane by lane */
+__attribute__((target("sse4.2")))
+void vec_span_sse(const long long *hi, const long long *lo, long n, long stride,
+                  wide *sum, long long *min, long long *max){
+  __m128i s, lo2 = _mm_set1_epi64x(LLONG_MAX);
+  __m128i hi2 = _mm_set1_epi64x(LLONG_MIN), d;
+  long long lane[2];
+  long i, block;
+  wide rest;
+  sum->hi = 0;
+  sum->lo = 0;
+  for(i = 0; i + 2 <= n; ){
+    s = _mm_setzero_si128();
+    for(block = 0; block < VEC_BLOCK && i + 2 <= n; block += 2, i += 2){
+      const long long *h = hi + i * stride, *l = lo + i * stride;
+      if(stride == 1){
+        d = _mm_sub_epi64(_mm_loadu_si128((const __m128i*)h),
+                          _mm_loadu_si128((const __m128i*)l));
+      }
+      else{
+        d = _mm_sub_epi64(_mm_set_epi64x(h[stride], h[0]),
+                          _mm_set_epi64x(l[stride], l[0]));
+      }
+      lo2 = _mm_blendv_epi8(lo2, d, _mm_cmpgt_epi64(lo2, d));
+      hi2 = _mm_blendv_epi8(hi2, d, _mm_cmpgt_epi64(d, hi2));
+      s = _mm_add_epi64(s, d);
+    }
+    _mm_storeu_si128((__m128i*)lane, s);
+    wide_add(sum, lane[0]);
+    wide_add(sum, lane[1]);
+  }
+  vec_span_scalar(hi + i * stride, lo + i * stride, n - i, stride, &rest, min, max);
+  sum->lo += rest.lo;
+  sum->hi += rest.hi + (sum->lo < rest.lo ? 1 : 0);
+  _mm_storeu_si128((__m128i*)lane, lo2);
+  *min = lane[0] < *min ? lane[0] : *min;
+  *min = lane[1] < *min ? lane[1] : *min;
+  _mm_storeu_si128((__m128i*)lane, hi2);
+  *max = lane[0] > *max ? lane[0] : *max;
+  *max = lane[1] > *max ? lane[1] : *max;
+}
+
+__attribute__((target("avx2")))
+void vec_span_avx2(const long long *hi, const long long *lo, long n, long stride,
+                   wide *sum, long long *min, long long *max){
+  __m256i s, lo4 = _mm256_set1_epi64x(LLONG_MAX);
+  __m256i hi4 = _mm256_set1_epi64x(LLONG_MIN), d, at;
+  long long lane[4];
+  long i, block;
+  int k;
+  wide rest;
+  sum->hi = 0;
+  sum->lo = 0;
+  at = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+  for(i = 0; i + 4 <= n; ){
+    s = _mm256_setzero_si256();
+    for(block = 0; block < VEC_BLOCK && i + 4 <= n; block += 4, i += 4){
+      const long long *h = hi + i * stride, *l = lo + i * stride;
+      if(stride == 1){
+        d = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i*)h),
+                             _mm256_loadu_si256((const __m256i*)l));
+      }
+      else{
+        d = _mm256_sub_epi64(_mm256_i64gather_epi64(h, at, 8),
+                             _mm256_i64gather_epi64(l, at, 8));
+      }
+      lo4 = _mm256_blendv_epi8(lo4, d, _mm256_cmpgt_epi64(lo4, d));
+      hi4 = _mm256_blendv_epi8(hi4, d, _mm256_cmpgt_epi64(d, hi4));
+      s = _mm256_add_epi64(s, d);
+    }
+    _mm256_storeu_si256((__m256i*)lane, s);
+    for(k = 0; k < 4; k++){
+      wide_add(sum, lane[k]);
+    }
+  }
+  vec_span_scalar(hi + i * stride, lo + i * stride, n - i, stride, &rest, min, max);
+  sum->lo += rest.lo;
+  sum->hi += rest.hi + (sum->lo < rest.lo ? 1 : 0);
+  _mm256_storeu_si256((__m256i*)lane, lo4);
+  for(k = 0; k < 4; k++){
+    if(lane[k] < *min){
+      *min = lane[k];
+    }
+  }
+  _mm256_storeu_si256((__m256i*)lane, hi4);
+  for(k = 0; k < 4; k++){
+    if(lane[k] > *max){
+      *max = lane[k];
+    }
+  }
+}
+#endif
+
+long vec_first_min(const long long *v, long n){
+#ifdef VEC_X86
+  switch(vec_pick()){
+    case VEC_AVX512:
+      return vec_first_min_avx512(v, n);
+    case VEC_AVX2:
+      return vec_first_min_avx2(v, n);
+    case VEC_SSE:
+      return vec_first_min_sse(v, n);
+  }
+#endif
+  return vec_first_min_scalar(v, n);
+}
+
+void vec_span(const long long *hi, const long long *lo, long n, long stride,
+              wide *sum, long long *min, long long *max){
+#ifdef VEC_X86
+  switch(vec_pick()){
+    case VEC_AVX512:
+    case VEC_AVX2:
+      vec_span_avx2(hi, lo, n, stride, sum, min, max);
+      return;
+    case VEC_SSE:
+      vec_span_sse(hi, lo, n, stride, sum, min, max);
+      return;
+  }
+#endif
+  vec_span_scalar(hi, lo, n, stride, sum, min, max);
+}
+
+/*
+ * Column files, for workloads and results too big for text.  Rows are cut
+ * into chunks of COL_CHUNK and every column of a chunk is encoded on its
+ * own, so a reader can go straight to one chunk, or hand chunks to
+ * threads.  Little endian throughout:
+ *
+ *   magic[4], version, columns, chunk rows  4 bytes each
+ *   rows                                    8 bytes
+ *   kind and bit width of each column       1 byte each, padded to 8
+ *   index, per chunk per column             8 byte offset, 8 byte length
+ *   the encoded chunks
+ *
+ * A COL_DELTA column stores each value as the step from the one before,
+ * starting from 0 in every chunk, a COL_VARINT column stores it as is,
+ * both as zigzag varints.  A COL_BITS column packs width bits per value,
+ * lowest first, and holds only values that fit.
+ */
+#define COL_VERSION 1
+#define COL_CHUNK 65536
+#define COL_DELTA 0
+#define COL_VARINT 1
+#define COL_BITS 2
+#define COL_VARINT_MAX 10   /* Bytes in the longest varint */
+
+typedef struct colfile{
+  unsigned char *map;       /* The whole file */
+  size_t length;
+  int cols;
+  long rows;
+  long chunk_rows;
+  long chunks;
+  unsigned char *kind;      /* Into map */
+  unsigned char *width;
+  unsigned char *index;
+}colfile;
+
+void col_put(unsigned char *p, unsigned long long v, int bytes){
+  int i;
+  for(i = 0; i < bytes; i++){
+    p[i] = (unsigned char)(v >> (8 * i));
+  }
+}
+
+unsigned long long col_get(const unsigned char *p, int bytes){
+  unsigned long long v = 0;
+  int i;
+  for(i = 0; i < bytes; i++){
+    v |= (unsigned long long)p[i] << (8 * i);
+  }
+  return v;
+}
+
+/* Bytes before the index */
+long col_header(int cols){
+  return (24 + 2 * cols + 7) / 8 * 8;
+}
+
+/* Encodes n values into out, returns the bytes used */
+long col_encode(const long long *v, long n, int kind, int width, unsigned char *out){
+  unsigned char *p = out;
+  unsigned long long z, bits = 0;
+  long long prev = 0, d;
+  int have = 0;
+  long i;
+  if(kind == COL_BITS){
+    for(i = 0; i < n; i++){
+      bits |= ((unsigned long long)v[i] & ((1ULL << width) - 1)) << have;
+      for(have += width; have >= 8; have -= 8){
+        *p++ = (unsigned char)bits;
+        bits >>= 8;
+      }
+    }
+    if(have > 0){
+      *p++ = (unsigned char)bits;
+    }
+    return p - out;
+  }
+  for(i = 0; i < n; i++){
+    d = kind == COL_DELTA ? (long long)((unsigned long long)v[i] - prev) : v[i];
+    prev = v[i];
+    z = (unsigned long long)d << 1 ^ (unsigned long long)(d >> 63);
+    while(z >= 0x80){
+      *p++ = (unsigned char)(z | 0x80);
+      z >>= 7;
+    }
+    *p++ = (unsigned char)z;
+  }
+  return p - out;
+}
+
+/* Decodes n values from in[0..len-1], a short input reads as zeros */
+void col_decode(const unsigned char *in, long len, long n, int kind, int width,
+                long long *v){
+  const unsigned char *p = in, *end = in + len;
+  unsigned long long z, bits = 0;
+  long long prev = 0, d;
+  int have = 0, shift;
+  long i;
+  if(kind == COL_BITS){
+    for(i = 0; i < n; i++){
+      while(have < width){
+        bits |= (unsigned long long)(p < end ? *p++ : 0) << have;
+        have += 8;
+      }
+      v[i] = (long long)(bits & ((1ULL << width) - 1));
+      bits >>= width;
+      have -= width;
+    }
+    return;
+  }
+  for(i = 0; i < n; i++){
+    z = 0;
+    for(shift = 0; p < end && shift < 64; shift += 7){
+      z |= (unsigned long long)(*p & 0x7F) << shift;
+      if(!(*p++ & 0x80)){
+        break;
+      }
+    }
+    d = (long long)(z >> 1) ^ -(long long)(z & 1);
+    if(kind == COL_DELTA){
+      d = (long long)((unsigned long long)d + prev);
+    }
+    prev = d;
+    v[i] = d;
+  }
+}
+
+/* Writes rows of cols columns to path, returns 0, or -1 with errno set */
+int col_write(const char *path, const char *magic, int cols,
+              const unsigned char *kind, const unsigned char *width,
+              long long **column, long rows){
+  long chunks = (rows + COL_CHUNK - 1) / COL_CHUNK;
+  long head = col_header(cols), offset, len, c, n;
+  unsigned char *header = (unsigned char*)calloc(head, 1);
+  unsigned char *index = (unsigned char*)calloc(chunks * cols, 16);
+  unsigned char *buf = (unsigned char*)malloc(COL_CHUNK * COL_VARINT_MAX);
+  FILE *f = fopen(path, "wb");
+  int k, ok = f != NULL && header != NULL && index != NULL && buf != NULL;
+
+  if(ok){
+    memcpy(header, magic, 4);
+    col_put(header + 4, COL_VERSION, 4);
+    col_put(header + 8, cols, 4);
+    col_put(header + 12, COL_CHUNK, 4);
+    col_put(header + 16, rows, 8);
+    memcpy(header + 24, kind, cols);
+    memcpy(header + 24 + cols, width, cols);
+    offset = head + chunks * cols * 16;
+    ok = fwrite(header, head, 1, f) == 1 && fseek(f, offset, SEEK_SET) == 0;
+  }
+  for(c = 0; ok && c < chunks; c++){
+    n = rows - c * COL_CHUNK < COL_CHUNK ? rows - c * COL_CHUNK : COL_CHUNK;
+    for(k = 0; ok && k < cols; k++){
+      len = col_encode(column[k] + c * COL_CHUNK, n, kind[k], width[k], buf);
+      col_put(index + (c * cols + k) * 16, offset, 8);
+      col_put(index + (c * cols + k) * 16 + 8, len, 8);
+      ok = len == 0 || fwrite(buf, len, 1, f) == 1;
+      offset += len;
+    }
+  }
+  if(ok && chunks > 0){
+    ok = fseek(f, head, SEEK_SET) == 0 && fwrite(index, chunks * cols * 16, 1, f) == 1;
+  }
+  if(f != NULL && fclose(f) != 0){
+    ok = 0;
+  }
+  free(header);
+  free(index);
+  free(buf);
+  return ok ? 0 : -1;
+}
+
+/* Maps a column file in, NULL if it can't or it isn't one with this magic */
+colfile *col_open(const char *path, const char *magic){
+  colfile *f;
+  struct stat st;
+  unsigned char *map;
+  long c, head;
+  int fd = open(path, O_RDONLY);
+  if(fd < 0){
+    return NULL;
+  }
+  if(fstat(fd, &st) != 0 || st.st_size < 24){
+    close(fd);
+    return NULL;
+  }
+  map = (unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return NULL;
+  }
+  f = (colfile*)malloc(sizeof(colfile));
+  f->map = map;
+  f->length = st.st_size;
+  f->cols = (int)col_get(map + 8, 4);
+  f->chunk_rows = (long)col_get(map + 12, 4);
+  f->rows = (long)col_get(map + 16, 8);
+  head = col_header(f->cols);
+  if(memcmp(map, magic, 4) != 0 || col_get(map + 4, 4) != COL_VERSION ||
+     f->cols < 1 || f->chunk_rows < 1 || f->rows < 0 ||
+     (unsigned long long)head > f->length){
+    munmap(map, st.st_size);
+    free(f);
+    return NULL;
+  }
+  f->chunks = (f->rows + f->chunk_rows - 1) / f->chunk_rows;
+  f->kind = map + 24;
+  f->width = map + 24 + f->cols;
+  f->index = map + head;
+  if((f->length - head) / 16 / f->cols < (unsigned long long)f->chunks){
+    munmap(map, st.st_size);
+    free(f);
+    return NULL;
+  }
+  for(c = 0; c < f->chunks * f->cols; c++){
+    unsigned long long at = col_get(f->index + c * 16, 8);
+    unsigned long long len = col_get(f->index + c * 16 + 8, 8);
+    if(at > f->length || len > f->length - at ||
+       (f->kind[c % f->cols] == COL_BITS && f->width[c % f->cols] > 32)){
+      munmap(map, st.st_size);
+      free(f);
+      return NULL;
+    }
+  }
+  return f;
+}
+
+void col_close(colfile *f){
+  munmap(f->map, f->length);
+  free(f);
+}
+
+/* Decodes chunk c of every column into column[k] at the chunk's first row */
+void col_chunk(colfile *f, long c, long long **column){
+  long first = c * f->chunk_rows;
+  long n = f->rows - first < f->chunk_rows ? f->rows - first : f->chunk_rows;
+  const unsigned char *at;
+  int k;
+  for(k = 0; k < f->cols; k++){
+    at = f->index + (c * f->cols + k) * 16;
+    col_decode(f->map + col_get(at, 8), (long)col_get(at + 8, 8), n,
+               f->kind[k], f->width[k], column[k] + first);
+  }
+}
+
+typedef struct col_job{
+  colfile *f;
+  long long **column;
+  long from, to;            /* Chunks */
+}col_job;
+
+void *col_work(void *arg){
+  col_job *job = (col_job*)arg;
+  long c;
+  for(c = job->from; c < job->to; c++){
+    col_chunk(job->f, c, job->column);
+  }
+  return NULL;
+}
+
+/* Decodes every row, column[k] holding rows values, the chunks split over threads */
+void col_read(colfile *f, long long **column){
+  pthread_t tid[MAX_WORKERS];
+  col_job jobs[MAX_WORKERS];
+  int t, threads = worker_count(f->chunks, 2);
+  for(t = 0; t < threads; t++){
+    jobs[t].f = f;
+    jobs[t].column = column;
+    jobs[t].from = f->chunks * t / threads;
+    jobs[t].to = f->chunks * (t + 1) / threads;
+  }
+  if(threads == 1){
+    col_work(&jobs[0]);
+    return;
+  }
+  for(t = 0; t < threads; t++){
+    pthread_create(&tid[t], NULL, col_work, &jobs[t]);
+  }
+  for(t = 0; t < threads; t++){
+    pthread_join(tid[t], NULL);
+  }
+}
+
+/*
+ * 128 bit content hash, two 64 bit multiply-xorshift lanes over 8 byte
+ * words.  Quick, not cryptographic.  Feeding the same pieces in the same
+ * order gives the same hash.
+ */
+typedef struct hash128{
+  unsigned long long a, b;
+  unsigned long long length;
+}hash128;
+
+void hash_init(hash128 *h){
+  h->a = 0x243F6A8885A308D3ULL;
+  h->b = 0x13198A2E03707344ULL;
+  h->length = 0;
+}
+
+void hash_word(hash128 *h, unsigned long long w){
+  h->a = (h->a ^ w) * 0x9E3779B97F4A7C15ULL;
+  h->a ^= h->a >> 32;
+  h->b = (h->b + w) * 0xC2B2AE3D27D4EB4FULL;
+  h->b ^= h->b >> 29;
+  h->length++;
+}
+
+void hash_bytes(hash128 *h, const void *p, size_t n){
+  const unsigned char *c = (const unsigned char*)p;
+  unsigned long long w;
+  for(; n >= 8; n -= 8, c += 8){
+    memcpy(&w, c, 8);
+    hash_word(h, w);
+  }
+  if(n > 0){
+    w = 0;
+    memcpy(&w, c, n);
+    hash_word(h, w ^ (unsigned long long)n << 56);
+  }
+}
+
+unsigned long long hash_mix(unsigned long long x){
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDULL;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ULL;
+  return x ^ x >> 33;
+}
+
+/* 32 hex digits and a NUL into out */
+void hash_hex(hash128 *h, char *out){
+  unsigned long long a = hash_mix(h->a ^ h->length), b = hash_mix(h->b ^ a);
+  sprintf(out, "%016llx%016llx", a, b);
+}
+
+/* Sends stdout to file until capture_end */
+typedef struct capture{
+  FILE *file;
+  int saved;
+}capture;
+
+int capture_begin(capture *c, FILE *file){
+  fflush(stdout);
+  c->file = file;
+  c->saved = dup(1);
+  if(c->saved < 0 || dup2(fileno(file), 1) < 0){
+    return -1;
+  }
+  return 0;
+}
+
+void capture_end(capture *c){
+  fflush(stdout);
+  dup2(c->saved, 1);
+  close(c->saved);
+}
+
+/*
+ * Keeps a cache directory within limit bytes.  Only files ours accepts
+ * count or go, whatever else lives there is left alone.  An entry is the
+ * files sharing a name up to the first dot, aged by the newest of them,
+ * and the least recently touched entries go first.
+ */
+typedef struct dir_file{
+  char name[256];
+  long long size;
+  time_t age;
+  long first, files;        /* An entry's files, by name order */
+}dir_file;
+
+int dir_file_by_name(const void *a, const void *b){
+  return strcmp(((const dir_file*)a)->name, ((const dir_file*)b)->name);
+}
+
+int dir_file_by_age(const void *a, const void *b){
+  time_t x = ((const dir_file*)a)->age, y = ((const dir_file*)b)->age;
+  return x < y ? -1 : x > y;
+}
+
+/* Length of the stem, the part up to the first dot */
+size_t dir_stem(const char *name){
+  const char *dot = strchr(name, '.');
+  return dot == NULL ? strlen(name) : (size_t)(dot - name);
+}
+
+void dir_trim(const char *dir, long long limit, int (*ours)(const char *name)){
+  DIR *d = opendir(dir);
+  struct dirent *e;
+  struct stat st;
+  dir_file *file = NULL, *entry;
+  long count = 0, room = 0, entries = 0, i, j;
+  long long total = 0;
+  char *path = (char*)malloc(strlen(dir) + 258);
+
+  while(d != NULL && (e = readdir(d)) != NULL){
+    if(e->d_name[0] == '.' || strlen(e->d_name) > 255 || !ours(e->d_name)){
+      continue;
+    }
+    sprintf(path, "%s/%s", dir, e->d_name);
+    if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)){
+      continue;
+    }
+    if(count == room){
+      room = room ? 2 * room : 64;
+      file = (dir_file*)realloc(file, room * sizeof(dir_file));
+    }
+    strcpy(file[count].name, e->d_name);
+    file[count].size = st.st_size;
+    file[count].age = st.st_mtime;
+    total += st.st_size;
+    count++;
+  }
+  if(d != NULL){
+    closedir(d);
+  }
+
+  if(total > limit){
+    /* Fold each entry's files into its first, by name */
+    qsort(file, count, sizeof(dir_file), dir_file_by_name);
+    entry = (dir_file*)malloc(count * sizeof(dir_file));
+    for(i = 0; i < count; i = j){
+      entry[entries] = file[i];
+      entry[entries].first = i;
+      for(j = i + 1; j < count && dir_stem(file[j].name) == dir_stem(file[i].name) &&
+          strncmp(file[j].name, file[i].name, dir_stem(file[i].name)) == 0; j++){
+        entry[entries].size += file[j].size;
+        if(file[j].age > entry[entries].age){
+          entry[entries].age = file[j].age;
+        }
+      }
+      entry[entries++].files = j - i;
+    }
+    qsort(entry, entries, sizeof(dir_file), dir_file_by_age);
+    for(i = 0; i < entries && total > limit; i++){
+      for(j = entry[i].first; j < entry[i].first + entry[i].files; j++){
+        sprintf(path, "%s/%s", dir, file[j].name);
+        unlink(path);
+      }
+      total -= entry[i].size;
+    }
+    free(entry);
+  }
+  free(file);
+  free(path);
+}
+
+/* Memory that forked children share with their parent, NULL if none */
+void *shared_region(long bytes){
+  void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                 -1, 0);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+void free_shared_region(void *p, long bytes){
+  munmap(p, bytes);
+}
+
+#define SHARD_POLL_US 2000  /* Coordinator's nap while workers run */
+
+/*
+ * Runs shards 0..shards-1 of a job in forked workers, at most workers at
+ * a time, each exiting once work is done with its shard.  A worker that
+ * crashes or exits non-zero has its shard queued again, up to tries runs
+ * in all, and the other shards carry on.  Workers report through a
+ * shared_region, and poll runs in the coordinator between reaps so it
+ * can take in what has landed.  Returns the shards that never finished.
+ */
+int fork_shards(int shards, int workers, int tries,
+                void (*work)(int shard, void *arg), void (*poll)(void *arg),
+                void *arg){
+  pid_t *pid = (pid_t*)calloc(workers, sizeof(pid_t)), done;
+  int *shard_of = (int*)malloc(workers * sizeof(int));
+  int *runs = (int*)calloc(shards, sizeof(int));
+  int *waiting = (int*)malloc(shards * sizeof(int));
+  int head = 0, count = shards, running = 0, failed = 0, w, s, status;
+
+  for(s = 0; s < shards; s++){
+    waiting[s] = s;
+  }
+  fflush(stdout);           /* Or children flush it again */
+  while(count > 0 || running > 0){
+    for(w = 0; w < workers && count > 0; w++){
+      if(pid[w] != 0){
+        continue;
+      }
+      s = waiting[head];
+      head = (head + 1) % shards;
+      count--;
+      runs[s]++;
+      pid[w] = fork();
+      if(pid[w] == 0){
+        work(s, arg);
+        _exit(0);
+      }
+      if(pid[w] < 0){
+        pid[w] = 0;
+        if(runs[s] < tries){
+          waiting[(head + count++) % shards] = s;
+        }
+        else{
+          failed++;
+        }
+        continue;
+      }
+      shard_of[w] = s;
+      running++;
+    }
+    if(running == 0){
+      continue;
+    }
+
+    done = waitpid(-1, &status, WNOHANG);
+    if(done == 0){
+      poll(arg);
+      usleep(SHARD_POLL_US);
+      continue;
+    }
+    if(done < 0){
+      break;
+    }
+    for(w = 0; w < workers && pid[w] != done; w++);
+    if(w == workers){
+      continue;
+    }
+    pid[w] = 0;
+    running--;
+    s = shard_of[w];
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+      if(runs[s] < tries){
+        waiting[(head + count++) % shards] = s;
+      }
+      else{
+        failed++;
+      }
+    }
+    poll(arg);
+  }
+  poll(arg);
+
+  free(pid);
+  free(shard_of);
+  free(runs);
+  free(waiting);
+  return failed;
+}
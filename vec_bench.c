@@ -0,0 +1,113 @@
+/*******************************************************************************
+*
+* vec_bench.c
+*
+* Times the vector kernels in utils.c against their scalar versions over
+* 10^6 jobs up to the count given, 10^8 by default, which needs about
+* 1.6GB.  Columns hold 64 bit times, runtimes of 10-39 as the simulator
+* draws them.
+*
+* The first min scan is how srt picks the next job, the stride 1 span is
+* a reduction over a column table, and the stride 8 span reads one time
+* in every eight, as average_time does over struct process.
+*
+* Usage: vec_bench [jobs]
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "utils.c"
+
+#define MIN_JOBS 1000000
+#define MAX_JOBS 100000000
+#define REPEAT 3          /* Best of this many runs */
+#define ROW 8             /* Times in a struct process */
+
+char *level_name[] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* Nanoseconds per job for one kernel at one level, best of REPEAT */
+double run(int kernel, int level, long long *hi, long long *lo, long n){
+  double best = 1e30, t;
+  wide sum;
+  long long min, max;
+  int r;
+  volatile long sink;
+
+  vec_level = level;
+  for(r = 0; r < REPEAT; r++){
+    t = now();
+    if(kernel == 0){
+      sink = vec_first_min(hi, n);
+    }
+    else if(kernel == 1){
+      vec_span(hi, lo, n, 1, &sum, &min, &max);
+      sink = sum.lo + min + max;
+    }
+    else{
+      vec_span(hi, lo, n / ROW, ROW, &sum, &min, &max);
+      sink = sum.lo + min + max;
+    }
+    t = now() - t;
+    if(t < best){
+      best = t;
+    }
+  }
+  (void)sink;
+  return best * 1e9 / (kernel == 2 ? n / ROW : n);
+}
+
+int main(int argc, char *argv[])
+{
+  char *kernel_name[] = {"first min", "span", "span /8"};
+  long jobs = argc > 1 ? atol(argv[1]) : MAX_JOBS;
+  long n, i;
+  long long *hi, *lo;
+  int k, level, top;
+
+  if(jobs < MIN_JOBS){
+    jobs = MIN_JOBS;
+  }
+  hi = (long long*)malloc(jobs * sizeof(long long));
+  lo = (long long*)malloc(jobs * sizeof(long long));
+  if(hi == NULL || lo == NULL){
+    printf("Not enough memory for %ld jobs\n", jobs);
+    return 1;
+  }
+  srand(0xC0FFEE);
+  for(i = 0; i < jobs; i++){
+    lo[i] = rand() % (5 * jobs);
+    hi[i] = lo[i] + (rand() % 30) + 10;
+  }
+
+  top = vec_pick();
+  printf("Widest kernels here are %s, ns per job\n", level_name[top]);
+  printf("jobs\t\tkernel\t");
+  for(level = 0; level <= top; level++){
+    printf("\t%s", level_name[level]);
+  }
+  printf("\tspeedup\n");
+  for(n = MIN_JOBS; n <= jobs; n *= 10){
+    for(k = 0; k < 3; k++){
+      double scalar = 0, t = 0;
+      printf("%ld\t%s\t", n, kernel_name[k]);
+      for(level = 0; level <= top; level++){
+        t = run(k, level, hi, lo, n);
+        if(level == VEC_SCALAR){
+          scalar = t;
+        }
+        printf("\t%.3f", t);
+      }
+      printf("\t%.1fx\n", scalar / t);
+    }
+  }
+
+  free(hi);
+  free(lo);
+  return 0;
+}